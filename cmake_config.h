@@ -66,6 +66,9 @@
 /* Define to 1 if you have the `strverscmp' function. */
 #cmakedefine HAVE_STRVERSCMP 1
 
+/* Define to 1 if `st_mtim.tv_nsec' is a member of `struct stat'. */
+#cmakedefine HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC 1
+
 /* Define to 1 if you have the <sys/stat.h> header file. */
 #cmakedefine HAVE_SYS_STAT_H 1
 
@@ -51,8 +51,12 @@
 #include "log.h"
 #include "backup.h"
 #include "package.h"
+#include "path.h"
+#include "hash.h"
+#include "bloom.h"
 #include "db.h"
 #include "provide.h"
+#include "requiredby.h"
 #include "conflict.h"
 #include "add.h"
 #include "remove.h"
@@ -85,9 +89,9 @@ static int add_faketarget(pmtrans_t *trans, const char *name)
 			continue;
 		}
 		if(strncmp("name", p, q-p) == 0) {
-			STRNCPY(dummy->name, q+1, PKG_NAME_LEN);
+			_pacman_pkg_set(dummy, PM_PKG_NAME, q+1);
 		} else if(strncmp("version", p, q-p) == 0) {
-			STRNCPY(dummy->version, q+1, PKG_VERSION_LEN);
+			_pacman_pkg_set(dummy, PM_PKG_VERSION, q+1);
 		} else if(strncmp("depend", p, q-p) == 0) {
 			dummy->depends = _pacman_list_add(dummy->depends, strdup(q+1));
 		} else {
@@ -153,7 +157,7 @@ int _pacman_add_addtarget(pmtrans_t *trans, const char *name)
 		if(trans->flags & PM_TRANS_FLAG_FRESHEN) {
 			/* only upgrade/install this package if it is already installed and at a lesser version */
 			dummy = _pacman_db_get_pkgfromcache(db, _pacman_pkg_getinfo(info, PM_PKG_NAME));
-			if(dummy == NULL || _pacman_versioncmp(dummy->version, info->version) >= 0) {
+			if(dummy == NULL || _pacman_pkg_vercmp(dummy, info) >= 0) {
 				pm_errno = PM_ERR_PKG_CANT_FRESH;
 				goto error;
 			}
@@ -165,7 +169,7 @@ int _pacman_add_addtarget(pmtrans_t *trans, const char *name)
 	for(i = trans->packages; i; i = i->next) {
 		pmpkg_t *pkg = i->data;
 		if(strcmp(pkg->name, _pacman_pkg_getinfo(info, PM_PKG_NAME)) == 0) {
-			if(_pacman_versioncmp(pkg->version, info->version) < 0) {
+			if(_pacman_pkg_vercmp(pkg, info) < 0) {
 				pmpkg_t *newpkg;
 				_pacman_log(PM_LOG_WARNING, _("replacing older version %s-%s by %s in target list"),
 				          pkg->name, pkg->version, info->version);
@@ -245,7 +249,7 @@ int _pacman_add_prepare(pmtrans_t *trans, pmlist_t **data)
 
 		/* re-order w.r.t. dependencies */
 		_pacman_log(PM_LOG_FLOW1, _("sorting by dependencies"));
-		lp = _pacman_sortbydeps(trans->packages, PM_TRANS_TYPE_ADD);
+		lp = _pacman_sortbydeps(trans, trans->packages, PM_TRANS_TYPE_ADD);
 		/* free the old alltargs */
 		FREELISTPTR(trans->packages);
 		trans->packages = lp;
@@ -281,7 +285,7 @@ int _pacman_add_prepare(pmtrans_t *trans, pmlist_t **data)
 			} else {
 				FREELIST(lp);
 			}
-			FREELIST(skiplist);
+			FREELISTPTR(skiplist);
 			RET_ERR(PM_ERR_FILE_CONFLICTS, -1);
 		}
 
@@ -311,7 +315,10 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 	char expath[PATH_MAX], cwd[PATH_MAX] = "", *what;
 	unsigned char cb_state;
 	time_t t;
-	pmlist_t *targ, *lp;
+	char installdate[32];
+	pmlist_t *targ, *lp, *requiredby;
+	pmdepcache_t *deps;
+	int n;
 	pmdb_t *db = trans->handle->db_local;
 
 	ASSERT(trans != NULL, RET_ERR(PM_ERR_TRANS_NULL, -1));
@@ -356,8 +363,6 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 						_pacman_db_read(db, INFRQ_FILES, local);
 					}
 					oldpkg->backup = _pacman_list_strdup(local->backup);
-					strncpy(oldpkg->name, local->name, PKG_NAME_LEN);
-					strncpy(oldpkg->version, local->version, PKG_VERSION_LEN);
 				}
 
 				/* pre_upgrade scriptlet */
@@ -383,7 +388,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 						RET_ERR(PM_ERR_TRANS_ABORT, -1);
 					}
 					/* copy the skiplist over */
-					tr->skiplist = _pacman_list_strdup(trans->skiplist);
+					tr->skiplist = _pacman_path_list_copy(trans->skiplist);
 					if(_pacman_remove_commit(tr, NULL) == -1) {
 						FREETRANS(tr);
 						RET_ERR(PM_ERR_TRANS_ABORT, -1);
@@ -440,6 +445,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 			for(i = 0; (archive_ret = archive_read_next_header (archive, &entry)) == ARCHIVE_OK; i++) {
 				int nb = 0;
 				int notouch = 0;
+				unsigned long pathhash;
 				char *md5_orig = NULL;
 				char *sha1_orig = NULL;
 				char pathname[PATH_MAX];
@@ -485,7 +491,10 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 				 * eg, /home/httpd/html/index.html may be removed so index.php
 				 * could be used.
 				 */
-				if(_pacman_list_is_strin(pathname, handle->noextract)) {
+				/* only hashed when a list is long enough to have a filter */
+				pathhash = (handle->noextractbloom || handle->noupgradebloom) ? _pacman_hash_str(pathname) : 0;
+				if(_pacman_bloom_test(handle->noextractbloom, pathhash) &&
+					_pacman_list_is_strin(pathname, handle->noextract)) {
 					pacman_logaction(_("notice: %s is in NoExtract -- skipping extraction"), pathname);
 					archive_read_data_skip (archive);
 					continue;
@@ -496,7 +505,8 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 					if(S_ISLNK(buf.st_mode)) {
 						continue;
 					} else if(!S_ISDIR(buf.st_mode)) {
-						if(_pacman_list_is_strin(pathname, handle->noupgrade)) {
+						if(_pacman_bloom_test(handle->noupgradebloom, pathhash) &&
+							_pacman_list_is_strin(pathname, handle->noupgrade)) {
 							notouch = 1;
 						} else {
 							if(!pmo_upgrade || oldpkg == NULL) {
@@ -549,7 +559,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 
 						if(!file) continue;
 						if(!strcmp(file, pathname)) {
-						    if(info->sha1sum != NULL && info->sha1sum != '\0') {
+						    if(PKG_COLD(info)->sha1sum != NULL && PKG_COLD(info)->sha1sum != '\0') {
 							/* 32 for the hash, 1 for the terminating NULL, and 1 for the tab delimiter */
 							if((fn = (char *)malloc(strlen(file)+34)) == NULL) {
 								RET_ERR(PM_ERR_MEMORY, -1);
@@ -569,7 +579,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 						}
 					}
 
-					if (info->sha1sum != NULL && info->sha1sum != '\0') {
+					if (PKG_COLD(info)->sha1sum != NULL && PKG_COLD(info)->sha1sum != '\0') {
 					_pacman_log(PM_LOG_DEBUG, _("checking md5 hashes for %s"), pathname);
 					_pacman_log(PM_LOG_DEBUG, _("current:  %s"), md5_local);
 					_pacman_log(PM_LOG_DEBUG, _("new:      %s"), md5_pkg);
@@ -694,7 +704,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 						if(!strcmp(file, pathname)) {
 							_pacman_log(PM_LOG_DEBUG, _("appending backup entry"));
 							snprintf(path, PATH_MAX, "%s%s", handle->root, file);
-							if (info->sha1sum != NULL && info->sha1sum != '\0') {
+							if (PKG_COLD(info)->sha1sum != NULL && PKG_COLD(info)->sha1sum != '\0') {
 							    md5 = _pacman_MDFile(path);
 							    /* 32 for the hash, 1 for the terminating NULL, and 1 for the tab delimiter */
 							    if((fn = (char *)malloc(strlen(file)+34)) == NULL) {
@@ -739,30 +749,18 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 		/* Add the package to the database */
 		t = time(NULL);
 
-		/* Update the requiredby field by scanning the whole database
-		 * looking for packages depending on the package to add */
-		for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
-			pmpkg_t *tmpp = lp->data;
-			pmlist_t *tmppm = NULL;
-			if(tmpp == NULL) {
-				continue;
-			}
-			for(tmppm = tmpp->depends; tmppm; tmppm = tmppm->next) {
-				pmdepend_t depend;
-				if(_pacman_splitdep(tmppm->data, &depend)) {
-					continue;
-				}
-				if(tmppm->data && (!strcmp(depend.name, info->name) || _pacman_list_is_strin(depend.name, info->provides))) {
-					_pacman_log(PM_LOG_DEBUG, _("adding '%s' in requiredby field for '%s'"), tmpp->name, info->name);
-					info->requiredby = _pacman_list_add(info->requiredby, strdup(tmpp->name));
-				}
-			}
+		/* Update the requiredby field from the reverse dependency index */
+		requiredby = _pacman_db_requiredby(db, info);
+		for(lp = requiredby; lp; lp = lp->next) {
+			info->requiredby = _pacman_list_add(info->requiredby, lp->data);
 		}
+		FREELISTPTR(requiredby);
 
 		/* make an install date (in UTC) */
-		STRNCPY(info->installdate, asctime(gmtime(&t)), sizeof(info->installdate));
+		STRNCPY(installdate, asctime(gmtime(&t)), sizeof(installdate));
 		/* remove the extra line feed appended by asctime() */
-		info->installdate[strlen(info->installdate)-1] = 0;
+		installdate[strlen(installdate)-1] = 0;
+		_pacman_pkg_set(info, PM_PKG_INSTALLDATE, installdate);
 
 		_pacman_log(PM_LOG_FLOW1, _("updating database"));
 		_pacman_log(PM_LOG_FLOW2, _("adding database entry '%s'"), info->name);
@@ -780,16 +778,14 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 		if(info->depends) {
 			_pacman_log(PM_LOG_FLOW2, _("updating dependency packages 'requiredby' fields"));
 		}
-		for(lp = info->depends; lp; lp = lp->next) {
+		deps = _pacman_parsedeps(info);
+		for(n = 0; deps && n < deps->count; n++) {
 			pmpkg_t *depinfo;
-			pmdepend_t depend;
-			if(_pacman_splitdep(lp->data, &depend)) {
-				continue;
-			}
-			depinfo = _pacman_db_get_pkgfromcache(db, depend.name);
+			const pmdepcons_t *depend = &deps->deps[n];
+			depinfo = _pacman_db_get_pkgfromcache(db, depend->name);
 			if(depinfo == NULL) {
 				/* look for a provides package */
-				pmlist_t *provides = _pacman_db_whatprovides(db, depend.name);
+				pmlist_t *provides = _pacman_db_whatprovides(db, depend->name);
 				if(provides) {
 					/* TODO: should check _all_ packages listed in provides, not just
 					 *       the first one.
@@ -799,13 +795,13 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 					FREELISTPTR(provides);
 				}
 				if(depinfo == NULL) {
-					_pacman_log(PM_LOG_ERROR, _("could not find dependency '%s'"), depend.name);
+					_pacman_log(PM_LOG_ERROR, _("could not find dependency '%s'"), depend->name);
 					/* wtf */
 					continue;
 				}
 			}
 			_pacman_log(PM_LOG_DEBUG, _("adding '%s' in requiredby field for '%s'"), info->name, depinfo->name);
-			depinfo->requiredby = _pacman_list_add(_pacman_pkg_getinfo(depinfo, PM_PKG_REQUIREDBY), strdup(info->name));
+			depinfo->requiredby = _pacman_list_add(_pacman_pkg_editlist(depinfo, _pacman_pkg_getinfo(depinfo, PM_PKG_REQUIREDBY)), strdup(info->name));
 			if(_pacman_db_write(db, depinfo, INFRQ_DEPENDS)) {
 				_pacman_log(PM_LOG_ERROR, _("could not update 'requiredby' database entry %s-%s"),
 				          depinfo->name, depinfo->version);
@@ -43,6 +43,11 @@
 #include "pacman.h"
 #include "error.h"
 #include "handle.h"
+#include "cache.h"
+#include "snapshot.h"
+#include "owners.h"
+#include "pool.h"
+#include "path.h"
 
 static inline int islocal(pmdb_t *db)
 {
@@ -54,37 +59,35 @@ static inline int islocal(pmdb_t *db)
 
 pmlist_t *_pacman_db_test(pmdb_t *db)
 {
-	struct dirent *ent;
+	const char *name;
 	char path[PATH_MAX];
 	struct stat buf;
 	pmlist_t *ret = NULL;
+	pmdir_t *dir;
 
 	/* testing sync dbs is not supported */
 	if (!islocal(db))
 		return ret;
 
-	while ((ent = readdir(db->handle)) != NULL) {
-		snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-		stat(path, &buf);
-		if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..") || !S_ISDIR(buf.st_mode)) {
-			continue;
-		}
-		snprintf(path, PATH_MAX, "%s/%s/desc", db->path, ent->d_name);
-		if(stat(path, &buf))
+	dir = db->handle;
+	while ((name = _pacman_readsubdir(dir)) != NULL) {
+		/* paths are relative to the db directory */
+		snprintf(path, PATH_MAX, "%s/desc", name);
+		if(fstatat(dir->fd, path, &buf, 0))
 		{
-			snprintf(path, LOG_STR_LEN, _("%s: description file is missing"), ent->d_name);
+			snprintf(path, LOG_STR_LEN, _("%s: description file is missing"), name);
 			ret = _pacman_list_add(ret, strdup(path));
 		}
-		snprintf(path, PATH_MAX, "%s/%s/depends", db->path, ent->d_name);
-		if(stat(path, &buf))
+		snprintf(path, PATH_MAX, "%s/depends", name);
+		if(fstatat(dir->fd, path, &buf, 0))
 		{
-			snprintf(path, LOG_STR_LEN, _("%s: dependency information is missing"), ent->d_name);
+			snprintf(path, LOG_STR_LEN, _("%s: dependency information is missing"), name);
 			ret = _pacman_list_add(ret, strdup(path));
 		}
-		snprintf(path, PATH_MAX, "%s/%s/files", db->path, ent->d_name);
-		if(stat(path, &buf))
+		snprintf(path, PATH_MAX, "%s/files", name);
+		if(fstatat(dir->fd, path, &buf, 0))
 		{
-			snprintf(path, LOG_STR_LEN, _("%s: file list is missing"), ent->d_name);
+			snprintf(path, LOG_STR_LEN, _("%s: file list is missing"), name);
 			ret = _pacman_list_add(ret, strdup(path));
 		}
 	}
@@ -98,28 +101,14 @@ int _pacman_db_open(pmdb_t *db)
 	}
 
 	if (islocal(db)) {
-		db->handle = opendir(db->path);
+		db->handle = _pacman_opendir(db->path);
 		if(db->handle == NULL) {
 			RET_ERR(PM_ERR_DB_OPEN, -1);
 		}
 	} else {
-		char dbpath[PATH_MAX];
-		snprintf(dbpath, PATH_MAX, "%s" PM_EXT_DB, db->path);
-		struct stat buf;
-		if(stat(dbpath, &buf) != 0) {
-			// db is not there, we'll open it later
-			db->handle = NULL;
-			return 0;
-		}
-		if((db->handle = archive_read_new()) == NULL) {
-			RET_ERR(PM_ERR_DB_OPEN, -1);
-		}
-		archive_read_support_compression_all(db->handle);
-		archive_read_support_format_all(db->handle);
-		if(archive_read_open_filename(db->handle, dbpath, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK) {
-			archive_read_finish(db->handle);
-			RET_ERR(PM_ERR_DB_OPEN, -1);
-		}
+		/* the archive is only opened by _pacman_db_rewind() when it has to be
+		 * parsed: most of the time the package cache comes from the snapshot */
+		db->handle = NULL;
 	}
 	if(_pacman_db_getlastupdate(db, db->lastupdate) == -1) {
 		db->lastupdate[0] = '\0';
@@ -134,9 +123,10 @@ void _pacman_db_close(pmdb_t *db)
 		return;
 	}
 
+	_pacman_db_snapshot_close(db);
 	if(db->handle) {
 		if (islocal(db))
-			closedir(db->handle);
+			_pacman_closedir(db->handle);
 		else
 			archive_read_finish(db->handle);
 		db->handle = NULL;
@@ -150,7 +140,7 @@ void _pacman_db_rewind(pmdb_t *db)
 	}
 
 	if (islocal(db)) {
-		rewinddir(db->handle);
+		_pacman_rewinddir(db->handle);
 	} else {
 		char dbpath[PATH_MAX];
 		snprintf(dbpath, PATH_MAX, "%s" PM_EXT_DB, db->path);
@@ -166,11 +156,47 @@ void _pacman_db_rewind(pmdb_t *db)
 	}
 }
 
+/* Resolves target to its local db entry through the package cache, or the
+ * snapshot index when the cache is not loaded, without walking the db.
+ * Returns -1 if neither can tell (or the entry they know is gone), the
+ * caller then has to scan the directory. Otherwise stores the entry in ret,
+ * or NULL if the package is not installed.
+ */
+static int _pacman_db_lookup(pmdb_t *db, const char *target, unsigned int inforeq, pmpkg_t **ret)
+{
+	pmpkg_t *pkg, *cached;
+
+	*ret = NULL;
+	if(db->pkgcache) {
+		if((cached = _pacman_db_get_pkgfromcache(db, target)) == NULL) {
+			return(0);
+		}
+		if((pkg = _pacman_pkg_new(cached->name, cached->version)) == NULL) {
+			return(-1);
+		}
+		/* the file list can come from the snapshot as well */
+		pkg->snapoff = cached->snapoff;
+	} else if(_pacman_db_snapshot_find(db, target, &pkg) == -1) {
+		return(-1);
+	} else if(pkg == NULL) {
+		return(0);
+	}
+
+	if(_pacman_db_read(db, inforeq & ~pkg->infolevel, pkg) == -1) {
+		/* no such directory: the index is stale */
+		FREEPKG(pkg);
+		return(-1);
+	}
+	/* everything asked for is read, do not rely on the mapping later */
+	pkg->snapoff = 0;
+	*ret = pkg;
+
+	return(0);
+}
+
 pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 {
-	struct dirent *ent = NULL;
-	struct stat sbuf;
-	char path[PATH_MAX];
+	const char *subdir = NULL;
 	char name[PKG_FULLNAME_LEN];
 	char *ptr = NULL;
 	int found = 0;
@@ -187,17 +213,13 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 	if(target != NULL) {
 		/* search for a specific package (by name only) */
 		if (islocal(db)) {
-			rewinddir(db->handle);
-			while(!found && (ent = readdir(db->handle)) != NULL) {
-				if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-					continue;
-				}
-				/* stat the entry, make sure it's a directory */
-				snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-				if(stat(path, &sbuf) || !S_ISDIR(sbuf.st_mode)) {
-					continue;
-				}
-				STRNCPY(name, ent->d_name, PKG_FULLNAME_LEN);
+			if(_pacman_db_lookup(db, target, inforeq, &pkg) == 0) {
+				return(pkg);
+			}
+
+			_pacman_rewinddir(db->handle);
+			while(!found && (subdir = _pacman_readsubdir(db->handle)) != NULL) {
+				STRNCPY(name, subdir, PKG_FULLNAME_LEN);
 				/* truncate the string at the second-to-last hyphen, */
 				/* which will give us the package name */
 				if((ptr = rindex(name, '-'))) {
@@ -211,8 +233,17 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 				}
 			}
 		} else {
+			/* the name index of the snapshot avoids inflating every entry
+			 * stored before the target */
+			if(_pacman_db_snapshot_find(db, target, &pkg) == 0) {
+				return(pkg);
+			}
+
 			// seek to start
-			_pacman_db_rewind(db->handle);
+			_pacman_db_rewind(db);
+			if(db->handle == NULL) {
+				return(NULL);
+			}
 
 			while (!found && archive_read_next_header(db->handle, &entry) == ARCHIVE_OK) {
 				// make sure it's a directory
@@ -241,19 +272,12 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 		int isdir = 0;
 		while(!isdir) {
 			if (islocal(db)) {
-				ent = readdir(db->handle);
-				if(ent == NULL) {
+				/* only directories are returned */
+				subdir = _pacman_readsubdir(db->handle);
+				if(subdir == NULL) {
 					return(NULL);
 				}
-				if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-					isdir = 0;
-					continue;
-				}
-				/* stat the entry, make sure it's a directory */
-				snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-				if(!stat(path, &sbuf) && S_ISDIR(sbuf.st_mode)) {
-					isdir = 1;
-				}
+				isdir = 1;
 			} else {
 				if (!db->handle)
 					_pacman_db_rewind(db);
@@ -268,23 +292,28 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 		}
 	}
 
-	pkg = _pacman_pkg_new(NULL, NULL);
-	if(pkg == NULL) {
-		return(NULL);
-	}
-	char *dname;
+	char *dname, pkgname[PKG_NAME_LEN], pkgver[PKG_VERSION_LEN];
 	if (islocal(db)) {
-		dname = strdup(ent->d_name);
+		dname = strdup(subdir);
 	} else {
 		dname = strdup(archive_entry_pathname(entry));
 		dname[strlen(dname)-1] = '\0'; // drop trailing slash
 	}
-	if(_pacman_pkg_splitname(dname, pkg->name, pkg->version, 0) == -1) {
+	if(_pacman_pkg_splitname(dname, pkgname, pkgver, 0) == -1) {
 		_pacman_log(PM_LOG_ERROR, _("invalid name for dabatase entry '%s'"), dname);
 		FREE(dname);
 		return(NULL);
 	}
 	FREE(dname);
+	if(target == NULL && db->pool) {
+		/* filling the package cache: the entry is read in its pool */
+		pkg = _pacman_pkg_new_pooled(db->pool, pkgname, pkgver);
+	} else {
+		pkg = _pacman_pkg_new(pkgname, pkgver);
+	}
+	if(pkg == NULL) {
+		return(NULL);
+	}
 	if(_pacman_db_read(db, inforeq, pkg) == -1) {
 		FREEPKG(pkg);
 	}
@@ -292,225 +321,248 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 	return(pkg);
 }
 
-static char *_pacman_db_read_fgets(pmdb_t *db, char *line, size_t size, FILE *fp)
+/* Where the desc and depends parsers take their lines from: a file of the
+ * local db, or an entry of the archive of a sync db loaded in memory. The
+ * lines of an entry are split and trimmed in place, and when the entry was
+ * loaded in the pool of the package they are used as they are.
+ */
+typedef struct __pmdbfile_t {
+	FILE *fp;
+	char *data;
+	char *ptr;
+	pmpool_t *pool; /* owner of data, NULL if malloc'ed */
+	char path[PATH_MAX]; /* of the local db file */
+	char line[512];
+} pmdbfile_t;
+
+/* Opens the file name of the local db entry of info */
+static int _pacman_db_fopen(pmdb_t *db, pmpkg_t *info, const char *name, pmdbfile_t *file)
 {
-	if (islocal(db))
-		return fgets(line, size, fp);
-	else
-		return _pacman_archive_fgets(line, size, db->handle);
+	file->data = file->ptr = NULL;
+	file->pool = NULL;
+	if(snprintf(file->path, PATH_MAX, "%s/%s-%s/%s", db->path, info->name, info->version, name) >= PATH_MAX) {
+		errno = ENAMETOOLONG;
+		return(-1);
+	}
+	if((file->fp = fopen(file->path, "r")) == NULL) {
+		return(-1);
+	}
+	return(0);
 }
 
-static int _pacman_db_read_desc(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
+/* Loads the current entry of the archive of db, from the pool of info if
+ * it has one.
+ */
+static int _pacman_db_fload(pmdb_t *db, struct archive_entry *entry, pmpkg_t *info, pmdbfile_t *file)
 {
-	FILE *fp = NULL;
-	char path[PATH_MAX];
-	char line[512];
-	int sline = sizeof(line)-1;
-	pmlist_t *i;
+	size_t size = archive_entry_size(entry), len = 0;
+	ssize_t ret;
+
+	file->fp = NULL;
+	file->pool = NULL;
+	if(info->pool) {
+		file->data = _pacman_pool_alloc(info->pool, size + 1);
+		file->pool = info->pool;
+	} else {
+		file->data = _pacman_malloc(size + 1);
+	}
+	if(file->data == NULL) {
+		return(-1);
+	}
+	while(len < size && (ret = archive_read_data(db->handle, file->data + len, size - len)) > 0) {
+		len += ret;
+	}
+	file->data[len] = '\0';
+	file->ptr = file->data;
 
-	if(inforeq & INFRQ_DESC) {
-		if (islocal(db)) {
-			snprintf(path, PATH_MAX, "%s/%s-%s/desc", db->path, info->name, info->version);
-			fp = fopen(path, "r");
-			if(fp == NULL) {
-				_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
-				goto error;
-			}
-		}
-		while(!islocal(db) || !feof(fp)) {
-			if(_pacman_db_read_fgets(db, line, 256, fp) == NULL) {
-				break;
-			}
-			_pacman_strtrim(line);
-			if(!strcmp(line, "%DESC%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->desc_localized = _pacman_list_add(info->desc_localized, strdup(line));
-				}
-				STRNCPY(info->desc, (char*)info->desc_localized->data, sizeof(info->desc));
-				for (i = info->desc_localized; i; i = i->next) {
-					if (!strncmp(i->data, handle->language, strlen(handle->language)) &&
-							*((char*)i->data+strlen(handle->language)) == ' ') {
-						STRNCPY(info->desc, (char*)i->data+strlen(handle->language)+1, sizeof(info->desc));
-					}
-				}
-				_pacman_strtrim(info->desc);
-			} else if(!strcmp(line, "%GROUPS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->groups = _pacman_list_add(info->groups, strdup(line));
-				}
-			} else if(!strcmp(line, "%URL%")) {
-				if(_pacman_db_read_fgets(db, info->url, sizeof(info->url), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->url);
-			} else if(!strcmp(line, "%LICENSE%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->license = _pacman_list_add(info->license, strdup(line));
-				}
-			} else if(!strcmp(line, "%ARCH%")) {
-				if(_pacman_db_read_fgets(db, info->arch, sizeof(info->arch), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->arch);
-			} else if(!strcmp(line, "%BUILDDATE%")) {
-				if(_pacman_db_read_fgets(db, info->builddate, sizeof(info->builddate), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->builddate);
-			} else if(!strcmp(line, "%BUILDTYPE%")) {
-				if(_pacman_db_read_fgets(db, info->buildtype, sizeof(info->buildtype), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->buildtype);
-			} else if(!strcmp(line, "%INSTALLDATE%")) {
-				if(_pacman_db_read_fgets(db, info->installdate, sizeof(info->installdate), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->installdate);
-			} else if(!strcmp(line, "%PACKAGER%")) {
-				if(_pacman_db_read_fgets(db, info->packager, sizeof(info->packager), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->packager);
-			} else if(!strcmp(line, "%REASON%")) {
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(tmp);
-				info->reason = atol(tmp);
-			} else if(!strcmp(line, "%SIZE%") || !strcmp(line, "%CSIZE%")) {
-				/* NOTE: the CSIZE and SIZE fields both share the "size" field
-				 *       in the pkginfo_t struct.  This can be done b/c CSIZE
-				 *       is currently only used in sync databases, and SIZE is
-				 *       only used in local databases.
-				 */
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(tmp);
-				info->size = atol(tmp);
-			} else if(!strcmp(line, "%USIZE%")) {
-				/* USIZE (uncompressed size) tag only appears in sync repositories,
-				 * not the local one. */
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(tmp);
-				info->usize = atol(tmp);
-			} else if(!strcmp(line, "%SHA1SUM%")) {
-				/* SHA1SUM tag only appears in sync repositories,
-				 * not the local one. */
-				if(_pacman_db_read_fgets(db, info->sha1sum, sizeof(info->sha1sum), fp) == NULL) {
-					goto error;
-				}
-			} else if(!strcmp(line, "%MD5SUM%")) {
-				/* MD5SUM tag only appears in sync repositories,
-				 * not the local one. */
-				if(_pacman_db_read_fgets(db, info->md5sum, sizeof(info->md5sum), fp) == NULL) {
-					goto error;
-				}
-			/* XXX: these are only here as backwards-compatibility for pacman
-			 * sync repos.... in pacman-g2, they have been moved to DEPENDS.
-			 * Remove this when we move to pacman-g2 repos.
-			 */
-			} else if(!strcmp(line, "%REPLACES%")) {
-				/* the REPLACES tag is special -- it only appears in sync repositories,
-				 * not the local one. */
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->replaces = _pacman_list_add(info->replaces, strdup(line));
-				}
-			} else if(!strcmp(line, "%FORCE%")) {
-				/* FORCE tag only appears in sync repositories,
-				 * not the local one. */
-				info->force = 1;
-			} else if(!strcmp(line, "%STICK%")) {
-				/* STICK tag only appears in sync repositories,
-				 * not the local one. */
-				info->stick = 1;
-			}
+	return(0);
+}
+
+static void _pacman_db_fclose(pmdbfile_t *file)
+{
+	if(file->fp) {
+		fclose(file->fp);
+		file->fp = NULL;
+	}
+	if(file->pool == NULL) {
+		FREE(file->data);
+	}
+}
+
+/* Returns the next line of file, trimmed, or NULL at the end of it */
+static char *_pacman_db_fgets(pmdbfile_t *file)
+{
+	char *line;
+
+	if(file->fp) {
+		if(fgets(file->line, sizeof(file->line), file->fp) == NULL) {
+			return(NULL);
 		}
-		if (fp)
-			fclose(fp);
-		fp = NULL;
+		return(_pacman_strtrim(file->line));
+	}
+	if(*file->ptr == '\0') {
+		return(NULL);
+	}
+	line = file->ptr;
+	if((file->ptr = strchr(line, '\n')) != NULL) {
+		*file->ptr++ = '\0';
+	} else {
+		file->ptr = line + strlen(line);
 	}
+	return(_pacman_strtrim(line));
+}
 
-	return(0);
+/* Appends the lines of file up to the next empty one to list */
+static pmlist_t *_pacman_db_fgetlist(pmdbfile_t *file, pmlist_t *list)
+{
+	char *line;
 
-error:
-	if(fp) {
-		fclose(fp);
+	while((line = _pacman_db_fgets(file)) != NULL && line[0] != '\0') {
+		if(file->pool) {
+			list = _pacman_pool_list_add(file->pool, list, line);
+		} else {
+			list = _pacman_list_add(list, strdup(line));
+		}
 	}
-	return(-1);
+	return(list);
 }
 
-static int _pacman_db_read_depends(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
+static int _pacman_db_read_desc(pmdbfile_t *file, pmpkg_t *info)
 {
-	FILE *fp = NULL;
-	char path[PATH_MAX];
-	char line[512];
-	int sline = sizeof(line)-1;
+	char *line;
+	pmpkgcold_t *cold;
 
-	if(inforeq & INFRQ_DEPENDS) {
-		if (islocal(db)) {
-			snprintf(path, PATH_MAX, "%s/%s-%s/depends", db->path, info->name, info->version);
-			fp = fopen(path, "r");
-			if(fp == NULL) {
-				_pacman_log(PM_LOG_WARNING, "%s (%s)", path, strerror(errno));
-				goto error;
+	while((line = _pacman_db_fgets(file)) != NULL) {
+		if(!strcmp(line, "%DESC%")) {
+			if((cold = _pacman_pkg_cold(info)) == NULL) {
+				return(-1);
 			}
-		}
-		while(!islocal(db) || !feof(fp)) {
-			if(_pacman_db_read_fgets(db, line, 256, fp) == NULL) {
-				break;
+			cold->desc_localized = _pacman_db_fgetlist(file, cold->desc_localized);
+			_pacman_pkg_localize_desc(info);
+		} else if(!strcmp(line, "%GROUPS%")) {
+			info->groups = _pacman_db_fgetlist(file, info->groups);
+		} else if(!strcmp(line, "%URL%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
 			}
-			_pacman_strtrim(line);
-			if(!strcmp(line, "%DEPENDS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->depends = _pacman_list_add(info->depends, strdup(line));
-				}
-			} else if(!strcmp(line, "%REQUIREDBY%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->requiredby = _pacman_list_add(info->requiredby, strdup(line));
-				}
-			} else if(!strcmp(line, "%CONFLICTS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->conflicts = _pacman_list_add(info->conflicts, strdup(line));
-				}
-			} else if(!strcmp(line, "%PROVIDES%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->provides = _pacman_list_add(info->provides, strdup(line));
-				}
-			} else if(!strcmp(line, "%REPLACES%")) {
-				/* the REPLACES tag is special -- it only appears in sync repositories,
-				 * not the local one. */
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->replaces = _pacman_list_add(info->replaces, strdup(line));
-				}
-			} else if(!strcmp(line, "%FORCE%")) {
-				/* FORCE tag only appears in sync repositories,
-				 * not the local one. */
-				info->force = 1;
-			} else if(!strcmp(line, "%STICK%")) {
-				/* STICK tag only appears in sync repositories,
-				 * not the local one. */
-				info->stick = 1;
+			_pacman_pkg_set(info, PM_PKG_URL, line);
+		} else if(!strcmp(line, "%LICENSE%")) {
+			if((cold = _pacman_pkg_cold(info)) == NULL) {
+				return(-1);
+			}
+			cold->license = _pacman_db_fgetlist(file, cold->license);
+		} else if(!strcmp(line, "%ARCH%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
 			}
+			_pacman_pkg_set(info, PM_PKG_ARCH, line);
+		} else if(!strcmp(line, "%BUILDDATE%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_BUILDDATE, line);
+		} else if(!strcmp(line, "%BUILDTYPE%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_BUILDTYPE, line);
+		} else if(!strcmp(line, "%INSTALLDATE%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_INSTALLDATE, line);
+		} else if(!strcmp(line, "%PACKAGER%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_PACKAGER, line);
+		} else if(!strcmp(line, "%REASON%")) {
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			info->reason = atol(line);
+		} else if(!strcmp(line, "%SIZE%") || !strcmp(line, "%CSIZE%")) {
+			/* NOTE: the CSIZE and SIZE fields both share the "size" field
+			 *       in the pkginfo_t struct.  This can be done b/c CSIZE
+			 *       is currently only used in sync databases, and SIZE is
+			 *       only used in local databases.
+			 */
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			info->size = atol(line);
+		} else if(!strcmp(line, "%USIZE%")) {
+			/* USIZE (uncompressed size) tag only appears in sync repositories,
+			 * not the local one. */
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			info->usize = atol(line);
+		} else if(!strcmp(line, "%SHA1SUM%")) {
+			/* SHA1SUM tag only appears in sync repositories,
+			 * not the local one. */
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_SHA1SUM, line);
+		} else if(!strcmp(line, "%MD5SUM%")) {
+			/* MD5SUM tag only appears in sync repositories,
+			 * not the local one. */
+			if((line = _pacman_db_fgets(file)) == NULL) {
+				return(-1);
+			}
+			_pacman_pkg_set(info, PM_PKG_MD5SUM, line);
+		/* XXX: these are only here as backwards-compatibility for pacman
+		 * sync repos.... in pacman-g2, they have been moved to DEPENDS.
+		 * Remove this when we move to pacman-g2 repos.
+		 */
+		} else if(!strcmp(line, "%REPLACES%")) {
+			/* the REPLACES tag is special -- it only appears in sync repositories,
+			 * not the local one. */
+			info->replaces = _pacman_db_fgetlist(file, info->replaces);
+		} else if(!strcmp(line, "%FORCE%")) {
+			/* FORCE tag only appears in sync repositories,
+			 * not the local one. */
+			info->force = 1;
+		} else if(!strcmp(line, "%STICK%")) {
+			/* STICK tag only appears in sync repositories,
+			 * not the local one. */
+			info->stick = 1;
 		}
-		if (fp)
-			fclose(fp);
-		fp = NULL;
 	}
 
 	return(0);
+}
 
-error:
-	if(fp) {
-		fclose(fp);
+static int _pacman_db_read_depends(pmdbfile_t *file, pmpkg_t *info)
+{
+	char *line;
+
+	while((line = _pacman_db_fgets(file)) != NULL) {
+		if(!strcmp(line, "%DEPENDS%")) {
+			info->depends = _pacman_db_fgetlist(file, info->depends);
+		} else if(!strcmp(line, "%REQUIREDBY%")) {
+			info->requiredby = _pacman_db_fgetlist(file, info->requiredby);
+		} else if(!strcmp(line, "%CONFLICTS%")) {
+			info->conflicts = _pacman_db_fgetlist(file, info->conflicts);
+		} else if(!strcmp(line, "%PROVIDES%")) {
+			info->provides = _pacman_db_fgetlist(file, info->provides);
+		} else if(!strcmp(line, "%REPLACES%")) {
+			/* the REPLACES tag is special -- it only appears in sync repositories,
+			 * not the local one. */
+			info->replaces = _pacman_db_fgetlist(file, info->replaces);
+		} else if(!strcmp(line, "%FORCE%")) {
+			/* FORCE tag only appears in sync repositories,
+			 * not the local one. */
+			info->force = 1;
+		} else if(!strcmp(line, "%STICK%")) {
+			/* STICK tag only appears in sync repositories,
+			 * not the local one. */
+			info->stick = 1;
+		}
 	}
-	return(-1);
+
+	return(0);
 }
 
 static int suffixcmp(const char *str, const char *suffix)
@@ -530,6 +582,8 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 	char line[512];
 	int sline = sizeof(line)-1;
 	char *ptr;
+	pmdbfile_t file;
+	int ret;
 
 	if(db == NULL) {
 		RET_ERR(PM_ERR_DB_NULL, -1);
@@ -547,11 +601,28 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 	}
 
 	if (islocal(db)) {
-		if (_pacman_db_read_desc(db, inforeq, info) == -1)
-			return -1;
-
-		if (_pacman_db_read_depends(db, inforeq, info) == -1)
-			return -1;
+		if(inforeq & INFRQ_DESC) {
+			if(_pacman_db_fopen(db, info, "desc", &file) == -1) {
+				_pacman_log(PM_LOG_DEBUG, "%s (%s)", file.path, strerror(errno));
+				return(-1);
+			}
+			ret = _pacman_db_read_desc(&file, info);
+			_pacman_db_fclose(&file);
+			if(ret == -1) {
+				return(-1);
+			}
+		}
+		if(inforeq & INFRQ_DEPENDS) {
+			if(_pacman_db_fopen(db, info, "depends", &file) == -1) {
+				_pacman_log(PM_LOG_WARNING, "%s (%s)", file.path, strerror(errno));
+				return(-1);
+			}
+			ret = _pacman_db_read_depends(&file, info);
+			_pacman_db_fclose(&file);
+			if(ret == -1) {
+				return(-1);
+			}
+		}
 	} else {
 		int descdone = 0, depsdone = 0;
 		while (!descdone || !depsdone) {
@@ -560,20 +631,36 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 				return -1;
 			const char *pathname = archive_entry_pathname(entry);
 			if (!suffixcmp(pathname, "/desc")) {
-				if (_pacman_db_read_desc(db, inforeq, info) == -1)
-					return -1;
+				if(inforeq & INFRQ_DESC) {
+					if(_pacman_db_fload(db, entry, info, &file) == -1) {
+						return(-1);
+					}
+					ret = _pacman_db_read_desc(&file, info);
+					_pacman_db_fclose(&file);
+					if(ret == -1) {
+						return(-1);
+					}
+				}
 				descdone = 1;
 			}
 			if (!suffixcmp(pathname, "/depends")) {
-				if (_pacman_db_read_depends(db, inforeq, info) == -1)
-					return -1;
+				if(inforeq & INFRQ_DEPENDS) {
+					if(_pacman_db_fload(db, entry, info, &file) == -1) {
+						return(-1);
+					}
+					ret = _pacman_db_read_depends(&file, info);
+					_pacman_db_fclose(&file);
+					if(ret == -1) {
+						return(-1);
+					}
+				}
 				depsdone = 1;
 			}
 		}
 	}
 
 	/* FILES */
-	if(inforeq & INFRQ_FILES) {
+	if((inforeq & INFRQ_FILES) && _pacman_db_snapshot_readfiles(db, info) == -1) {
 		snprintf(path, PATH_MAX, "%s/%s-%s/files", db->path, info->name, info->version);
 		fp = fopen(path, "r");
 		if(fp == NULL) {
@@ -588,7 +675,7 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 						/* just ignore the content after the pipe for now */
 						*ptr = '\0';
 					}
-					info->files = _pacman_list_add(info->files, strdup(line));
+					info->files = _pacman_list_add(info->files, (char *)_pacman_path_intern(line));
 				}
 			} else if(!strcmp(line, "%BACKUP%")) {
 				while(fgets(line, sline, fp) && strlen(_pacman_strtrim(line))) {
@@ -626,6 +713,7 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 	char path[PATH_MAX];
 	mode_t oldmask;
 	pmlist_t *lp = NULL;
+	const pmpkgcold_t *cold;
 	int retval = 0;
 	int local = 0;
 
@@ -633,6 +721,9 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 		return(-1);
 	}
 
+	_pacman_db_snapshot_invalidate(db);
+	_pacman_db_owners_check(db);
+
 	snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
 	oldmask = umask(0000);
 	mkdir(path, 0755);
@@ -653,9 +744,10 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 		}
 		fprintf(fp, "%%NAME%%\n%s\n\n"
 			"%%VERSION%%\n%s\n\n", info->name, info->version);
-		if(info->desc[0]) {
+		cold = PKG_COLD(info);
+		if(cold->desc[0]) {
 			fputs("%DESC%\n", fp);
-			for(lp = info->desc_localized; lp; lp = lp->next) {
+			for(lp = cold->desc_localized; lp; lp = lp->next) {
 				fprintf(fp, "%s\n", (char *)lp->data);
 			}
 			fprintf(fp, "\n");
@@ -668,13 +760,13 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 			fprintf(fp, "\n");
 		}
 		if(local) {
-			if(info->url[0]) {
+			if(cold->url[0]) {
 				fprintf(fp, "%%URL%%\n"
-					"%s\n\n", info->url);
+					"%s\n\n", cold->url);
 			}
-			if(info->license) {
+			if(cold->license) {
 				fputs("%LICENSE%\n", fp);
-				for(lp = info->license; lp; lp = lp->next) {
+				for(lp = cold->license; lp; lp = lp->next) {
 					fprintf(fp, "%s\n", (char *)lp->data);
 				}
 				fprintf(fp, "\n");
@@ -683,21 +775,21 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 				fprintf(fp, "%%ARCH%%\n"
 					"%s\n\n", info->arch);
 			}
-			if(info->builddate[0]) {
+			if(cold->builddate[0]) {
 				fprintf(fp, "%%BUILDDATE%%\n"
-					"%s\n\n", info->builddate);
+					"%s\n\n", cold->builddate);
 			}
-			if(info->buildtype[0]) {
+			if(cold->buildtype[0]) {
 				fprintf(fp, "%%BUILDTYPE%%\n"
-					"%s\n\n", info->buildtype);
+					"%s\n\n", cold->buildtype);
 			}
-			if(info->installdate[0]) {
+			if(cold->installdate[0]) {
 				fprintf(fp, "%%INSTALLDATE%%\n"
-					"%s\n\n", info->installdate);
+					"%s\n\n", cold->installdate);
 			}
-			if(info->packager[0]) {
+			if(cold->packager[0]) {
 				fprintf(fp, "%%PACKAGER%%\n"
-					"%s\n\n", info->packager);
+					"%s\n\n", cold->packager);
 			}
 			if(info->size) {
 				fprintf(fp, "%%SIZE%%\n"
@@ -716,12 +808,12 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 				fprintf(fp, "%%USIZE%%\n"
 					"%ld\n\n", info->usize);
 			}
-			if(info->sha1sum) {
+			if(cold->sha1sum) {
 				fprintf(fp, "%%SHA1SUM%%\n"
-					"%s\n\n", info->sha1sum);
-			} else if(info->md5sum) {
+					"%s\n\n", cold->sha1sum);
+			} else if(cold->md5sum) {
 				fprintf(fp, "%%MD5SUM%%\n"
-					"%s\n\n", info->md5sum);
+					"%s\n\n", cold->md5sum);
 			}
 		}
 		fclose(fp);
@@ -821,6 +913,12 @@ cleanup:
 		fclose(fp);
 	}
 
+	if(retval == 0) {
+		_pacman_db_owners_update(db, info, (local && (inforeq & INFRQ_FILES)) ? PM_OWNERS_ADD : PM_OWNERS_STAMP);
+	} else if(local) {
+		_pacman_db_owners_invalidate(db);
+	}
+
 	return(retval);
 }
 
@@ -832,14 +930,63 @@ int _pacman_db_remove(pmdb_t *db, pmpkg_t *info)
 		RET_ERR(PM_ERR_DB_NULL, -1);
 	}
 
+	_pacman_db_snapshot_invalidate(db);
+	_pacman_db_owners_check(db);
+
 	snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
 	if(_pacman_rmrf(path) == -1) {
+		_pacman_db_owners_invalidate(db);
 		return(-1);
 	}
+	_pacman_db_owners_update(db, info, PM_OWNERS_REMOVE);
 
 	return(0);
 }
 
+/* Folds the stat of the files of the local db entry of name-version selected
+ * by inforeq into a stamp, so that an entry edited in place gets a new one.
+ * A missing file counts as well.
+ */
+unsigned long long _pacman_db_stamp(pmdb_t *db, const char *name, const char *version, unsigned int inforeq)
+{
+	static const struct {
+		unsigned int infrq;
+		const char *file;
+	} files[] = {
+		{ INFRQ_DESC, "desc" },
+		{ INFRQ_DEPENDS, "depends" },
+		{ INFRQ_FILES, "files" },
+		{ INFRQ_SCRIPLET, "install" }
+	};
+	unsigned long long stamp = 14695981039346656037ULL; /* FNV-1a */
+	char path[PATH_MAX];
+	struct stat buf;
+	unsigned int i, j;
+
+	for(i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		unsigned long long fields[4];
+
+		if(!(inforeq & files[i].infrq)) {
+			continue;
+		}
+		snprintf(path, PATH_MAX, "%s/%s-%s/%s", db->path, name, version, files[i].file);
+		memset(fields, 0, sizeof(fields));
+		if(stat(path, &buf) == 0) {
+			fields[0] = buf.st_ino;
+			fields[1] = buf.st_size;
+			fields[2] = buf.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+			fields[3] = buf.st_mtim.tv_nsec;
+#endif
+		}
+		for(j = 0; j < sizeof(fields); j++) {
+			stamp = (stamp ^ ((unsigned char *)fields)[j]) * 1099511628211ULL;
+		}
+	}
+
+	return(stamp);
+}
+
 /* reads dbpath/.lastupdate and populates *ts with the contents.
  * *ts should be malloc'ed and should be at least 15 bytes.
  *
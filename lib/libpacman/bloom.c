@@ -0,0 +1,83 @@
+/*
+ *  bloom.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+/* pacman-g2 */
+#include "util.h"
+#include "list.h"
+#include "hash.h"
+#include "path.h"
+#include "bloom.h"
+
+#define BLOOM_BITS_PER_ITEM 10
+#define BLOOM_MINBITS 64
+
+/* Returns an empty filter sized for count strings */
+pmbloom_t *_pacman_bloom_new(unsigned long count)
+{
+	pmbloom_t *bloom;
+	unsigned long bits;
+
+	for(bits = BLOOM_MINBITS; bits < count * BLOOM_BITS_PER_ITEM; bits *= 2);
+	if((bloom = _pacman_zalloc(sizeof(pmbloom_t) + bits / 8)) == NULL) {
+		return(NULL);
+	}
+	bloom->mask = bits - 1;
+	return(bloom);
+}
+
+/* Returns a filter of a list of interned paths (see path.c), NULL if the
+ * list is too short to need one */
+pmbloom_t *_pacman_bloom_paths(pmlist_t *paths)
+{
+	pmbloom_t *bloom;
+	pmlist_t *lp;
+	int count = _pacman_list_count(paths);
+
+	if(count < PM_BLOOM_MINITEMS || (bloom = _pacman_bloom_new(count)) == NULL) {
+		return(NULL);
+	}
+	for(lp = paths; lp; lp = lp->next) {
+		_pacman_bloom_add(bloom, _pacman_path_hash(lp->data));
+	}
+	return(bloom);
+}
+
+/* Returns a filter of a list of strings, NULL if the list is too short to
+ * need one */
+pmbloom_t *_pacman_bloom_strs(pmlist_t *strs)
+{
+	pmbloom_t *bloom;
+	pmlist_t *lp;
+	int count = _pacman_list_count(strs);
+
+	if(count < PM_BLOOM_MINITEMS || (bloom = _pacman_bloom_new(count)) == NULL) {
+		return(NULL);
+	}
+	for(lp = strs; lp; lp = lp->next) {
+		_pacman_bloom_add(bloom, _pacman_hash_str(lp->data));
+	}
+	return(bloom);
+}
+
+/* vim: set ts=2 sw=2 noet: */
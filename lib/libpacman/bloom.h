@@ -0,0 +1,87 @@
+/*
+ *  bloom.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BLOOM_H
+#define _PACMAN_BLOOM_H
+
+#include "list.h"
+
+/* Bloom filter over strings, given by their _pacman_hash_str() value: a
+ * negative test means the string is not in the set, a positive one has to be
+ * confirmed by an exact lookup.  About 10 bits per string, for 1% of false
+ * positives.
+ *
+ * A list shorter than PM_BLOOM_MINITEMS gets no filter: it is scanned about
+ * as fast as a string is hashed.
+ */
+typedef struct __pmbloom_t {
+	unsigned long mask; /* the number of bits minus 1, a power of 2 minus 1 */
+	unsigned char bits[];
+} pmbloom_t;
+
+#define PM_BLOOM_PROBES 4
+#define PM_BLOOM_MINITEMS 8
+
+pmbloom_t *_pacman_bloom_new(unsigned long count);
+pmbloom_t *_pacman_bloom_paths(pmlist_t *paths);
+pmbloom_t *_pacman_bloom_strs(pmlist_t *strs);
+
+/* The second hash of the double hashing, never even */
+static inline unsigned long _pacman_bloom_step(unsigned long hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bUL;
+	hash ^= hash >> 16;
+	return(hash | 1);
+}
+
+static inline void _pacman_bloom_add(pmbloom_t *bloom, unsigned long hash)
+{
+	unsigned long step = _pacman_bloom_step(hash), bit;
+	int i;
+
+	for(i = 0; i < PM_BLOOM_PROBES; i++, hash += step) {
+		bit = hash & bloom->mask;
+		bloom->bits[bit >> 3] |= 1 << (bit & 7);
+	}
+}
+
+/* Whether hash may be in the set: always true without a filter */
+static inline int _pacman_bloom_test(const pmbloom_t *bloom, unsigned long hash)
+{
+	unsigned long step, bit;
+	int i;
+
+	if(bloom == NULL) {
+		return(1);
+	}
+	step = _pacman_bloom_step(hash);
+	for(i = 0; i < PM_BLOOM_PROBES; i++, hash += step) {
+		bit = hash & bloom->mask;
+		if(!(bloom->bits[bit >> 3] & (1 << (bit & 7)))) {
+			return(0);
+		}
+	}
+	return(1);
+}
+
+#endif /* _PACMAN_BLOOM_H */
+
+/* vim: set ts=2 sw=2 noet: */
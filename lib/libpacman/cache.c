@@ -33,13 +33,38 @@
 #include "log.h"
 #include "pacman.h"
 #include "list.h"
+#include "hash.h"
+#include "pool.h"
 #include "util.h"
 #include "package.h"
 #include "group.h"
 #include "db.h"
 #include "handle.h"
 #include "error.h"
+#include "provide.h"
+#include "requiredby.h"
 #include "cache.h"
+#include "snapshot.h"
+
+/* Indexes the package cache by name. When a name shows up more than once,
+ * the first entry wins, like it does for a walk of the list.
+ */
+static int _pacman_db_hash_pkgcache(pmdb_t *db)
+{
+	pmlist_t *lp;
+
+	db->pkghash = _pacman_hash_new(_pacman_vector_count(db->pkgcache));
+	if(db->pkghash == NULL) {
+		return(-1);
+	}
+	for(lp = _pacman_vector_list(db->pkgcache); lp; lp = lp->next) {
+		pmpkg_t *pkg = lp->data;
+		if(_pacman_hash_get(db->pkghash, pkg->name) == NULL) {
+			_pacman_hash_add(db->pkghash, pkg->name, pkg);
+		}
+	}
+	return(0);
+}
 
 /* Returns a new package cache from db.
  * It frees the cache if it already exists.
@@ -55,32 +80,62 @@ int _pacman_db_load_pkgcache(pmdb_t *db)
 
 	_pacman_db_free_pkgcache(db);
 
+	if(_pacman_db_snapshot_load(db) == 0) {
+		return(_pacman_db_hash_pkgcache(db));
+	}
+
 	if (db != handle->db_local)
 		inforeq = INFRQ_DESC | INFRQ_DEPENDS;
 	_pacman_log(PM_LOG_DEBUG, _("loading package cache (infolevel=%#x) for repository '%s'"),
 	                        inforeq, db->treename);
 
+	if((db->pkgcache = _pacman_vector_new(0)) == NULL) {
+		return(-1);
+	}
+	if(db != handle->db_local) {
+		/* keep the archive entries around, their lines are used in place */
+		db->pool = _pacman_pool_new(0);
+	}
 	_pacman_db_rewind(db);
 	while((info = _pacman_db_scan(db, NULL, inforeq)) != NULL) {
 		info->origin = PKG_FROM_CACHE;
 		info->data = db;
 		/* add to the collective */
-		db->pkgcache = _pacman_list_add_sorted(db->pkgcache, info, _pacman_pkg_cmp);
+		_pacman_vector_add(db->pkgcache, info);
 	}
+	_pacman_vector_sort(db->pkgcache, _pacman_pkg_cmp);
 
-	return(0);
+	if(handle->access == PM_ACCESS_RW) {
+		/* next time, load it in one go */
+		_pacman_db_snapshot_write(db);
+	}
+
+	return(_pacman_db_hash_pkgcache(db));
 }
 
 void _pacman_db_free_pkgcache(pmdb_t *db)
 {
-	if(db == NULL || db->pkgcache == NULL) {
+	if(db == NULL) {
+		return;
+	}
+
+	_pacman_db_snapshot_close(db);
+	FREEHASH(db->pkghash);
+	_pacman_db_provides_free(db);
+	_pacman_db_requiredby_free(db);
+	if(db->pkgcache == NULL) {
 		return;
 	}
 
 	_pacman_log(PM_LOG_DEBUG, _("freeing package cache for repository '%s'"),
 	                        db->treename);
 
-	FREELISTPKGS(db->pkgcache);
+	_FREEVECTOR(db->pkgcache, _pacman_pkg_free);
+	if(db->pool) {
+		_pacman_log(PM_LOG_DEBUG, _("releasing %lu bytes (%lu allocations) in %lu blocks"),
+		          db->pool->bytes, db->pool->allocs, db->pool->nchunks);
+		FREEPOOL(db->pool);
+	}
 
 	if(db->grpcache) {
 		_pacman_db_free_grpcache(db);
@@ -97,7 +152,7 @@ pmlist_t *_pacman_db_get_pkgcache(pmdb_t *db)
 		_pacman_db_load_pkgcache(db);
 	}
 
-	return(db->pkgcache);
+	return(_pacman_vector_list(db->pkgcache));
 }
 
 int _pacman_db_add_pkgincache(pmdb_t *db, pmpkg_t *pkg)
@@ -113,7 +168,17 @@ int _pacman_db_add_pkgincache(pmdb_t *db, pmpkg_t *pkg)
 		return(-1);
 	}
 	_pacman_log(PM_LOG_DEBUG, _("adding entry '%s' in '%s' cache"), newpkg->name, db->treename);
-	db->pkgcache = _pacman_list_add_sorted(db->pkgcache, newpkg, _pacman_pkg_cmp);
+	if(db->pkgcache == NULL && (db->pkgcache = _pacman_vector_new(0)) == NULL) {
+		FREEPKG(newpkg);
+		return(-1);
+	}
+	_pacman_vector_add_sorted(db->pkgcache, newpkg, _pacman_pkg_cmp);
+	/* the new entry is inserted before any other of the same name */
+	if(db->pkghash) {
+		_pacman_hash_add(db->pkghash, newpkg->name, newpkg);
+	}
+	_pacman_db_provides_add(db, newpkg);
+	_pacman_db_requiredby_add(db, newpkg);
 
 	_pacman_db_free_grpcache(db);
 
@@ -128,13 +193,23 @@ int _pacman_db_remove_pkgfromcache(pmdb_t *db, pmpkg_t *pkg)
 		return(-1);
 	}
 
-	db->pkgcache = _pacman_list_remove(db->pkgcache, pkg, _pacman_pkg_cmp, (void **)&data);
+	data = _pacman_vector_remove(db->pkgcache, pkg, _pacman_pkg_cmp);
 	if(data == NULL) {
 		/* package not found */
 		return(-1);
 	}
 
 	_pacman_log(PM_LOG_DEBUG, _("removing entry '%s' from '%s' cache"), pkg->name, db->treename);
+	if(db->pkghash) {
+		pmpkg_t *next;
+
+		_pacman_hash_remove(db->pkghash, data->name);
+		if((next = _pacman_vector_bsearch(db->pkgcache, data, _pacman_pkg_cmp)) != NULL) {
+			_pacman_hash_add(db->pkghash, next->name, next);
+		}
+	}
+	_pacman_db_provides_remove(db, data);
+	_pacman_db_requiredby_remove(db, data);
 	FREEPKG(data);
 
 	_pacman_db_free_grpcache(db);
@@ -148,7 +223,14 @@ pmpkg_t *_pacman_db_get_pkgfromcache(pmdb_t *db, const char *target)
 		return(NULL);
 	}
 
-	return(_pacman_pkg_isin(target, _pacman_db_get_pkgcache(db)));
+	if(db->pkgcache == NULL) {
+		_pacman_db_load_pkgcache(db);
+	}
+	if(db->pkghash == NULL) {
+		_pacman_db_hash_pkgcache(db);
+	}
+
+	return(_pacman_hash_get(db->pkghash, target));
 }
 
 /* Returns a new group cache from db.
@@ -156,6 +238,7 @@ pmpkg_t *_pacman_db_get_pkgfromcache(pmdb_t *db, const char *target)
 int _pacman_db_load_grpcache(pmdb_t *db)
 {
 	pmlist_t *lp;
+	pmhash_t *groups;
 
 	if(db == NULL) {
 		return(-1);
@@ -167,7 +250,14 @@ int _pacman_db_load_grpcache(pmdb_t *db)
 
 	_pacman_log(PM_LOG_DEBUG, _("loading group cache for repository '%s'"), db->treename);
 
-	for(lp = db->pkgcache; lp; lp = lp->next) {
+	/* groups are collected unsorted, then each list is sorted once */
+	if((db->grpcache = _pacman_vector_new(0)) == NULL) {
+		return(-1);
+	}
+	if((groups = _pacman_hash_new(0)) == NULL) {
+		return(-1);
+	}
+	for(lp = _pacman_vector_list(db->pkgcache); lp; lp = lp->next) {
 		pmlist_t *i;
 		pmpkg_t *pkg = lp->data;
 
@@ -176,27 +266,27 @@ int _pacman_db_load_grpcache(pmdb_t *db)
 		}
 
 		for(i = pkg->groups; i; i = i->next) {
-			if(!_pacman_list_is_strin(i->data, db->grpcache)) {
-				pmgrp_t *grp = _pacman_grp_new();
+			pmgrp_t *grp = _pacman_hash_get(groups, i->data);
 
+			if(grp == NULL) {
+				grp = _pacman_grp_new();
 				STRNCPY(grp->name, (char *)i->data, GRP_NAME_LEN);
-				grp->packages = _pacman_list_add_sorted(grp->packages, pkg->name, _pacman_grp_cmp);
-				db->grpcache = _pacman_list_add_sorted(db->grpcache, grp, _pacman_grp_cmp);
-			} else {
-				pmlist_t *j;
-
-				for(j = db->grpcache; j; j = j->next) {
-					pmgrp_t *grp = j->data;
-
-					if(strcmp(grp->name, i->data) == 0) {
-						if(!_pacman_list_is_strin(pkg->name, grp->packages)) {
-							grp->packages = _pacman_list_add_sorted(grp->packages, (char *)pkg->name, _pacman_grp_cmp);
-						}
-					}
-				}
+				_pacman_hash_add(groups, grp->name, grp);
+				_pacman_vector_add(db->grpcache, grp);
+			}
+			/* the cache is sorted by name: a duplicate can only be the last one */
+			if(grp->packages == NULL || strcmp(_pacman_list_last(grp->packages)->data, pkg->name)) {
+				grp->packages = _pacman_list_add(grp->packages, (char *)pkg->name);
 			}
 		}
 	}
+	FREEHASH(groups);
+
+	_pacman_vector_sort(db->grpcache, _pacman_grp_cmp);
+	for(lp = _pacman_vector_list(db->grpcache); lp; lp = lp->next) {
+		pmgrp_t *grp = lp->data;
+		grp->packages = _pacman_list_sort(grp->packages, _pacman_grp_cmp);
+	}
 
 	return(0);
 }
@@ -209,13 +299,13 @@ void _pacman_db_free_grpcache(pmdb_t *db)
 		return;
 	}
 
-	for(lg = db->grpcache; lg; lg = lg->next) {
+	for(lg = _pacman_vector_list(db->grpcache); lg; lg = lg->next) {
 		pmgrp_t *grp = lg->data;
 
 		FREELISTPTR(grp->packages);
 		FREEGRP(lg->data);
 	}
-	FREELIST(db->grpcache);
+	_FREEVECTOR(db->grpcache, NULL);
 }
 
 pmlist_t *_pacman_db_get_grpcache(pmdb_t *db)
@@ -228,26 +318,21 @@ pmlist_t *_pacman_db_get_grpcache(pmdb_t *db)
 		_pacman_db_load_grpcache(db);
 	}
 
-	return(db->grpcache);
+	return(_pacman_vector_list(db->grpcache));
 }
 
 pmgrp_t *_pacman_db_get_grpfromcache(pmdb_t *db, const char *target)
 {
-	pmlist_t *i;
-
 	if(db == NULL || target == NULL || strlen(target) == 0) {
 		return(NULL);
 	}
 
-	for(i = _pacman_db_get_grpcache(db); i; i = i->next) {
-		pmgrp_t *info = i->data;
-
-		if(strcmp(info->name, target) == 0) {
-			return(info);
-		}
+	if(db->grpcache == NULL) {
+		_pacman_db_load_grpcache(db);
 	}
 
-	return(NULL);
+	/* the group name is the first member of pmgrp_t */
+	return(_pacman_vector_bsearch(db->grpcache, target, _pacman_grp_cmp));
 }
 
 int _pacman_sync_cleancache(int level)
@@ -40,18 +40,109 @@
 #include "log.h"
 #include "cache.h"
 #include "deps.h"
+#include "hash.h"
+#include "pool.h"
+#include "package.h"
+#include "provide.h"
+#include "probe.h"
+#include "path.h"
 #include "conflict.h"
 
+/* The indexes of _pacman_checkconflicts() */
+typedef struct __pmconflicter_t {
+	pmhash_t *targets; /* names and provisions of the targets to the list of these */
+	pmhash_t *upgrades; /* names of the targets to the last of these */
+	pmhash_t *conflicts; /* names to the installed packages conflicting with them */
+	pmpool_t *pool; /* lists of targets and conflicts */
+} pmconflicter_t;
+
+static pmhash_t *_pacman_conflicter_add(pmconflicter_t *conflicter, pmhash_t *hash, const char *key, pmpkg_t *pkg)
+{
+	pmlist_t *list = _pacman_hash_get(hash, key);
+
+	if(list == NULL) {
+		_pacman_hash_add(hash, key, _pacman_pool_list_add(conflicter->pool, NULL, pkg));
+	} else if(list->last->data != pkg) {
+		_pacman_pool_list_add(conflicter->pool, list, pkg);
+	}
+	return(hash);
+}
+
+/* Indexes the targets by name and provisions, and the installed packages by
+ * conflicts.  An installed package being upgraded conflicts with what its
+ * new version conflicts with.
+ */
+static int _pacman_conflicter_init(pmconflicter_t *conflicter, pmdb_t *db, pmlist_t *packages)
+{
+	pmlist_t *i, *j;
+
+	conflicter->targets = _pacman_hash_new(0);
+	conflicter->upgrades = _pacman_hash_new(0);
+	conflicter->conflicts = _pacman_hash_new(0);
+	conflicter->pool = _pacman_pool_new(0);
+	if(!conflicter->targets || !conflicter->upgrades || !conflicter->conflicts || !conflicter->pool) {
+		return(-1);
+	}
+
+	for(i = packages; i; i = i->next) {
+		pmpkg_t *pkg = i->data;
+		if(pkg == NULL) {
+			continue;
+		}
+		_pacman_conflicter_add(conflicter, conflicter->targets, pkg->name, pkg);
+		for(j = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); j; j = j->next) {
+			_pacman_conflicter_add(conflicter, conflicter->targets, j->data, pkg);
+		}
+		_pacman_hash_remove(conflicter->upgrades, pkg->name);
+		_pacman_hash_add(conflicter->upgrades, pkg->name, pkg);
+	}
+
+	for(i = _pacman_db_get_pkgcache(db); i; i = i->next) {
+		pmpkg_t *info = i->data;
+		pmpkg_t *pkg = _pacman_hash_get(conflicter->upgrades, info->name);
+
+		for(j = _pacman_pkg_getinfo(pkg ? pkg : info, PM_PKG_CONFLICTS); j; j = j->next) {
+			_pacman_conflicter_add(conflicter, conflicter->conflicts, j->data, info);
+		}
+	}
+	return(0);
+}
+
+static void _pacman_conflicter_fini(pmconflicter_t *conflicter)
+{
+	FREEHASH(conflicter->targets);
+	FREEHASH(conflicter->upgrades);
+	FREEHASH(conflicter->conflicts);
+	if(conflicter->pool) {
+		_pacman_pool_free(conflicter->pool);
+		conflicter->pool = NULL;
+	}
+}
+
+static pmlist_t *_pacman_conflict_add(pmlist_t *baddeps, pmpkg_t *tp, pmpkg_t *dp)
+{
+	pmdepmissing_t *miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, dp->name, NULL);
+
+	if(!_pacman_depmiss_isin(miss, baddeps)) {
+		baddeps = _pacman_list_add(baddeps, miss);
+	} else {
+		FREE(miss);
+	}
+	return(baddeps);
+}
+
 /* Returns a pmlist_t* of pmdepmissing_t pointers.
  *
  * conflicts are always name only
+ *
+ * The conflicts of a target are looked up in the indexes, and the installed
+ * packages found are reported in the order of the database.
  */
 pmlist_t *_pacman_checkconflicts(pmtrans_t *trans, pmdb_t *db, pmlist_t *packages)
 {
-	pmpkg_t *info = NULL;
+	pmconflicter_t conflicter;
 	pmlist_t *i, *j, *k;
 	pmlist_t *baddeps = NULL;
-	pmdepmissing_t *miss = NULL;
 	int howmany, remain;
 	double percent;
 
@@ -59,10 +150,18 @@ pmlist_t *_pacman_checkconflicts(pmtrans_t *trans, pmdb_t *db, pmlist_t *package
 		return(NULL);
 	}
 
+	memset(&conflicter, 0, sizeof(pmconflicter_t));
+	if(_pacman_conflicter_init(&conflicter, db, packages) == -1) {
+		_pacman_conflicter_fini(&conflicter);
+		RET_ERR(PM_ERR_MEMORY, NULL);
+	}
+
 	howmany = _pacman_list_count(packages);
 
 	for(i = packages; i; i = i->next) {
 		pmpkg_t *tp = i->data;
+		pmlist_t *found;
+		pmpkg_t *prev;
 		if(tp == NULL) {
 			continue;
 		}
@@ -76,304 +175,358 @@ pmlist_t *_pacman_checkconflicts(pmtrans_t *trans, pmdb_t *db, pmlist_t *package
 		}
 
 		for(j = _pacman_pkg_getinfo(tp, PM_PKG_CONFLICTS); j; j = j->next) {
+			pmpkg_t *dp;
 			if(!strcmp(tp->name, j->data)) {
 				/* a package cannot conflict with itself -- that's just not nice */
 				continue;
 			}
 			/* CHECK 1: check targets against database */
 			_pacman_log(PM_LOG_DEBUG, _("checkconflicts: targ '%s' vs db"), tp->name);
-			for(k = _pacman_db_get_pkgcache(db); k; k = k->next) {
-				pmpkg_t *dp = (pmpkg_t *)k->data;
-				if(!strcmp(dp->name, tp->name)) {
+			found = _pacman_db_whatprovides(db, j->data);
+			if((dp = _pacman_db_get_pkgfromcache(db, j->data)) != NULL) {
+				found = _pacman_list_add(found, dp);
+			}
+			found = _pacman_list_sort(found, _pacman_pkg_cmp);
+			for(k = found, prev = NULL; k; prev = k->data, k = k->next) {
+				dp = k->data;
+				if(dp == prev || !strcmp(dp->name, tp->name)) {
 					/* a package cannot conflict with itself -- that's just not nice */
 					continue;
 				}
-				if(!strcmp(j->data, dp->name)) {
-					/* conflict */
-					_pacman_log(PM_LOG_DEBUG, _("targs vs db: found %s as a conflict for %s"),
-					          dp->name, tp->name);
-					miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, dp->name, NULL);
-					if(!_pacman_depmiss_isin(miss, baddeps)) {
-						baddeps = _pacman_list_add(baddeps, miss);
-					} else {
-						FREE(miss);
-					}
-				} else {
-					/* see if dp provides something in tp's conflict list */
-					pmlist_t *m;
-					for(m = _pacman_pkg_getinfo(dp, PM_PKG_PROVIDES); m; m = m->next) {
-						if(!strcmp(m->data, j->data)) {
-							/* confict */
-							_pacman_log(PM_LOG_DEBUG, _("targs vs db: found %s as a conflict for %s"),
-							          dp->name, tp->name);
-							miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, dp->name, NULL);
-							if(!_pacman_depmiss_isin(miss, baddeps)) {
-								baddeps = _pacman_list_add(baddeps, miss);
-							} else {
-								FREE(miss);
-							}
-						}
-					}
-				}
+				_pacman_log(PM_LOG_DEBUG, _("targs vs db: found %s as a conflict for %s"),
+				          dp->name, tp->name);
+				baddeps = _pacman_conflict_add(baddeps, tp, dp);
 			}
+			FREELISTPTR(found);
 			/* CHECK 2: check targets against targets */
 			_pacman_log(PM_LOG_DEBUG, _("checkconflicts: targ '%s' vs targs"), tp->name);
-			for(k = packages; k; k = k->next) {
-				pmpkg_t *otp = (pmpkg_t *)k->data;
+			for(k = _pacman_hash_get(conflicter.targets, j->data); k; k = k->next) {
+				pmpkg_t *otp = k->data;
 				if(!strcmp(otp->name, tp->name)) {
 					/* a package cannot conflict with itself -- that's just not nice */
 					continue;
 				}
-				if(!strcmp(otp->name, (char *)j->data)) {
-					/* otp is listed in tp's conflict list */
-					_pacman_log(PM_LOG_DEBUG, _("targs vs targs: found %s as a conflict for %s"),
-					          otp->name, tp->name);
-					miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, otp->name, NULL);
-					if(!_pacman_depmiss_isin(miss, baddeps)) {
-						baddeps = _pacman_list_add(baddeps, miss);
-					} else {
-						FREE(miss);
-					}
-				} else {
-					/* see if otp provides something in tp's conflict list */
-					pmlist_t *m;
-					for(m = _pacman_pkg_getinfo(otp, PM_PKG_PROVIDES); m; m = m->next) {
-						if(!strcmp(m->data, j->data)) {
-							_pacman_log(PM_LOG_DEBUG, _("targs vs targs: found %s as a conflict for %s"),
-							          otp->name, tp->name);
-							miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, otp->name, NULL);
-							if(!_pacman_depmiss_isin(miss, baddeps)) {
-								baddeps = _pacman_list_add(baddeps, miss);
-							} else {
-								FREE(miss);
-							}
-						}
-					}
-				}
+				_pacman_log(PM_LOG_DEBUG, _("targs vs targs: found %s as a conflict for %s"),
+				          otp->name, tp->name);
+				baddeps = _pacman_conflict_add(baddeps, tp, otp);
 			}
 		}
 		/* CHECK 3: check database against targets */
 		_pacman_log(PM_LOG_DEBUG, _("checkconflicts: db vs targ '%s'"), tp->name);
-		for(k = _pacman_db_get_pkgcache(db); k; k = k->next) {
-			pmlist_t *conflicts = NULL;
-			int usenewconflicts = 0;
-
-			info = k->data;
-			if(!strcmp(info->name, tp->name)) {
+		found = NULL;
+		for(k = _pacman_hash_get(conflicter.conflicts, tp->name); k; k = k->next) {
+			found = _pacman_list_add(found, k->data);
+		}
+		/* see if the db package conflicts with something we provide */
+		for(j = _pacman_pkg_getinfo(tp, PM_PKG_PROVIDES); j; j = j->next) {
+			for(k = _pacman_hash_get(conflicter.conflicts, j->data); k; k = k->next) {
+				found = _pacman_list_add(found, k->data);
+			}
+		}
+		found = _pacman_list_sort(found, _pacman_pkg_cmp);
+		for(k = found, prev = NULL; k; prev = k->data, k = k->next) {
+			pmpkg_t *info = k->data;
+			if(info == prev || !strcmp(info->name, tp->name)) {
 				/* a package cannot conflict with itself -- that's just not nice */
 				continue;
 			}
-			/* If this package (*info) is also in our packages pmlist_t, use the
-			 * conflicts list from the new package, not the old one (*info)
-			 */
-			for(j = packages; j; j = j->next) {
-				pmpkg_t *pkg = j->data;
-				if(!strcmp(pkg->name, info->name)) {
-					/* Use the new, to-be-installed package's conflicts */
-					conflicts = _pacman_pkg_getinfo(pkg, PM_PKG_CONFLICTS);
-					usenewconflicts = 1;
-				}
-			}
-			if(!usenewconflicts) {
-				/* Use the old package's conflicts, it's the only set we have */
-				conflicts = _pacman_pkg_getinfo(info, PM_PKG_CONFLICTS);
-			}
-			for(j = conflicts; j; j = j->next) {
-				if(!strcmp((char *)j->data, tp->name)) {
-					_pacman_log(PM_LOG_DEBUG, _("db vs targs: found %s as a conflict for %s"),
-					          info->name, tp->name);
-					miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, info->name, NULL);
-					if(!_pacman_depmiss_isin(miss, baddeps)) {
-						baddeps = _pacman_list_add(baddeps, miss);
-					} else {
-						FREE(miss);
-					}
-				} else {
-					/* see if the db package conflicts with something we provide */
-					pmlist_t *m;
-					for(m = conflicts; m; m = m->next) {
-						pmlist_t *n;
-						for(n = _pacman_pkg_getinfo(tp, PM_PKG_PROVIDES); n; n = n->next) {
-							if(!strcmp(m->data, n->data)) {
-								_pacman_log(PM_LOG_DEBUG, _("db vs targs: found %s as a conflict for %s"),
-								          info->name, tp->name);
-								miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_CONFLICT, PM_DEP_MOD_ANY, info->name, NULL);
-								if(!_pacman_depmiss_isin(miss, baddeps)) {
-									baddeps = _pacman_list_add(baddeps, miss);
-								} else {
-									FREE(miss);
-								}
-							}
-						}
-					}
-				}
-			}
+			_pacman_log(PM_LOG_DEBUG, _("db vs targs: found %s as a conflict for %s"),
+			          info->name, tp->name);
+			baddeps = _pacman_conflict_add(baddeps, tp, info);
 		}
+		FREELISTPTR(found);
 	}
 
+	_pacman_conflicter_fini(&conflicter);
 	return(baddeps);
 }
 
-/* Returns a pmlist_t* of file conflicts.
- *  Hooray for set-intersects!
- *  Pre-condition: both lists are sorted!
+/* A target of _pacman_db_find_conflicts() */
+typedef struct __pmfiletarget_t {
+	pmpkg_t *pkg;
+	pmpkg_t *dbpkg; /* its installed version, if any */
+	int pos;
+} pmfiletarget_t;
+
+/* The owners of a path */
+typedef struct __pmfileowner_t {
+	pmlist_t *targets; /* targets having the path, in order */
+	pmlist_t *olders; /* targets whose installed version has the path, in order */
+} pmfileowner_t;
+
+/* A file shared by two targets */
+typedef struct __pmfileshare_t {
+	const char *file;
+	pmfiletarget_t *target;
+} pmfileshare_t;
+
+static int _pacman_fileshare_cmp(const void *s1, const void *s2)
+{
+	const pmfileshare_t *share1 = s1, *share2 = s2;
+
+	if(share1->target->pos != share2->target->pos) {
+		return(share1->target->pos - share2->target->pos);
+	}
+	return(strcmp(share1->file, share2->file));
+}
+
+static pmfileowner_t *_pacman_fileowner_get(pmfileowner_t **owners, pmpool_t *pool, const char *path)
+{
+	pmfileowner_t **owner = &owners[_pacman_path_id(path)];
+
+	if(*owner == NULL && (*owner = _pacman_pool_alloc(pool, sizeof(pmfileowner_t))) != NULL) {
+		(*owner)->targets = (*owner)->olders = NULL;
+	}
+	return(*owner);
+}
+
+static pmlist_t *_pacman_fileowner_add(pmpool_t *pool, pmlist_t *list, pmfiletarget_t *target)
+{
+	if(list == NULL) {
+		return(_pacman_pool_list_add(pool, NULL, target));
+	}
+	if(list->last->data != target) {
+		_pacman_pool_list_add(pool, list, target);
+	}
+	return(list);
+}
+
+/* Whether the installed version of target has the path of owner: the path
+ * can then not conflict, whatever is on the file system.
+ */
+static int _pacman_fileowner_isold(pmfileowner_t *owner, pmfiletarget_t *target)
+{
+	pmlist_t *i;
+
+	for(i = owner ? owner->olders : NULL; i; i = i->next) {
+		if(((pmfiletarget_t *)i->data)->dbpkg == target->dbpkg) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/* Indexes the files of the targets and of their installed versions by path
+ * id (see path.c).
  */
-static pmlist_t *chk_fileconflicts(pmlist_t *filesA, pmlist_t *filesB)
+static pmfileowner_t **_pacman_fileowner_index(pmdb_t *db, pmvector_t *targets, pmpool_t *pool)
 {
-	pmlist_t *ret = NULL;
-	pmlist_t *pA = filesA, *pB = filesB;
-
-	while(pA && pB) {
-		const char *strA = pA->data;
-		const char *strB = pB->data;
-		/* skip directories, we don't care about dir conflicts */
-		if(strA[strlen(strA)-1] == '/') {
-			pA = pA->next;
-		} else if(strB[strlen(strB)-1] == '/') {
-			pB = pB->next;
-		} else {
-			int cmp = strcmp(strA, strB);
-			if(cmp < 0) {
-				/* item only in filesA, ignore it */
-				pA = pA->next;
-			} else if(cmp > 0) {
-				/* item only in filesB, ignore it */
-				pB = pB->next;
-			} else {
-				/* item in both, record it */
-				ret = _pacman_list_add(ret, strdup(strA));
-				pA = pA->next;
-				pB = pB->next;
+	pmfileowner_t **owners;
+	pmlist_t *i, *j;
+
+	/* the paths of the installed versions have to be interned first */
+	for(i = _pacman_vector_list(targets); i; i = i->next) {
+		pmfiletarget_t *target = i->data;
+		if(target->dbpkg && !(target->dbpkg->infolevel & INFRQ_FILES)) {
+			_pacman_log(PM_LOG_DEBUG, _("loading FILES info for '%s'"), target->dbpkg->name);
+			_pacman_db_read(db, INFRQ_FILES, target->dbpkg);
+		}
+	}
+	if((owners = _pacman_zalloc((_pacman_path_count() + 1) * sizeof(pmfileowner_t *))) == NULL) {
+		return(NULL);
+	}
+	for(i = _pacman_vector_list(targets); i; i = i->next) {
+		pmfiletarget_t *target = i->data;
+		pmfileowner_t *owner;
+
+		for(j = target->pkg->files; j; j = j->next) {
+			if((owner = _pacman_fileowner_get(owners, pool, j->data)) != NULL) {
+				owner->targets = _pacman_fileowner_add(pool, owner->targets, target);
 			}
-	  }
+		}
+		if(target->dbpkg == NULL) {
+			continue;
+		}
+		for(j = target->dbpkg->files; j; j = j->next) {
+			if((owner = _pacman_fileowner_get(owners, pool, j->data)) != NULL) {
+				owner->olders = _pacman_fileowner_add(pool, owner->olders, target);
+			}
+		}
 	}
+	return(owners);
+}
+
+static pmlist_t *_pacman_conflict_add_file(pmlist_t *conflicts, unsigned char type, pmpkg_t *pkg,
+                                           const char *file, pmpkg_t *cpkg)
+{
+	pmconflict_t *conflict = _pacman_malloc(sizeof(pmconflict_t));
 
-	return(ret);
+	if(conflict == NULL) {
+		return(conflicts);
+	}
+	conflict->type = type;
+	STRNCPY(conflict->target, pkg->name, PKG_NAME_LEN);
+	STRNCPY(conflict->file, file, CONFLICT_FILE_LEN);
+	if(cpkg) {
+		STRNCPY(conflict->ctarget, cpkg->name, PKG_NAME_LEN);
+	} else {
+		conflict->ctarget[0] = 0;
+	}
+	return(_pacman_list_add(conflicts, conflict));
 }
 
+/* Returns a pmlist_t* of file conflicts.
+ *
+ * The files of the targets and of their installed versions are indexed once
+ * by path id, and each file of a target is then resolved from its owners: the
+ * following targets having it conflict with it, and an existing file is fine
+ * if the installed version of the target has it, or if it is moved from an
+ * other target (see skip_list below).
+ */
 pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pmlist_t **skip_list)
 {
 	pmlist_t *i, *j, *k;
 	char *filestr = NULL;
-	char path[PATH_MAX+1];
-	struct stat buf;
 	pmlist_t *conflicts = NULL;
 	pmlist_t *targets = trans->packages;
-	pmpkg_t *p, *dbpkg;
+	pmvector_t *vector;
+	pmfileowner_t **owners;
+	pmpool_t *pool;
+	pmprobe_t *probes = NULL, *probe;
 	double percent;
-	int howmany, remain;
+	int howmany, remain, count = 0;
 
 	if(db == NULL || targets == NULL || root == NULL) {
 		return(NULL);
 	}
 	howmany = _pacman_list_count(targets);
 
-	/* CHECK 1: check every target against every target */
+	vector = _pacman_vector_new(howmany);
+	pool = _pacman_pool_new(0);
+	if(vector == NULL || pool == NULL) {
+		_FREEVECTOR(vector, NULL);
+		if(pool) {
+			_pacman_pool_free(pool);
+		}
+		RET_ERR(PM_ERR_MEMORY, NULL);
+	}
+	for(i = targets; i; i = i->next) {
+		pmfiletarget_t *target = _pacman_pool_alloc(pool, sizeof(pmfiletarget_t));
+		if(target == NULL) {
+			continue;
+		}
+		target->pkg = i->data;
+		target->dbpkg = _pacman_db_get_pkgfromcache(db, target->pkg->name);
+		target->pos = _pacman_vector_count(vector);
+		_pacman_vector_add(vector, target);
+	}
+	owners = _pacman_fileowner_index(db, vector, pool);
+
+	/* probe the file system for all the files which may conflict at once */
 	for(i = targets; i; i = i->next) {
-		pmpkg_t *p1 = (pmpkg_t*)i->data;
-		remain = _pacman_list_count(i);
+		count += _pacman_list_count(((pmpkg_t *)i->data)->files);
+	}
+	if(owners == NULL || (count && (probes = _pacman_malloc(count * sizeof(pmprobe_t))) == NULL)) {
+		FREE(owners);
+		_pacman_pool_free(pool);
+		_FREEVECTOR(vector, NULL);
+		RET_ERR(PM_ERR_MEMORY, NULL);
+	}
+	count = 0;
+	for(i = _pacman_vector_list(vector); i; i = i->next) {
+		for(j = ((pmfiletarget_t *)i->data)->pkg->files; j; j = j->next) {
+			if(!_pacman_fileowner_isold(owners[_pacman_path_id(j->data)], i->data)) {
+				probes[count++].file = j->data;
+			}
+		}
+	}
+	_pacman_probe(root, probes, count);
+	probe = probes;
+
+	for(i = _pacman_vector_list(vector); i; i = i->next) {
+		pmfiletarget_t *target = i->data;
+		pmpkg_t *p = target->pkg;
+		pmlist_t *shares = NULL;
+
+		remain = howmany - target->pos;
 		percent = (double)(howmany - remain + 1) / howmany;
 		PROGRESS(trans, PM_TRANS_PROGRESS_CONFLICTS_START, "", (percent * 100), howmany, howmany - remain + 1);
-		for(j = i; j; j = j->next) {
-			pmpkg_t *p2 = (pmpkg_t*)j->data;
-			if(strcmp(p1->name, p2->name)) {
-				pmlist_t *ret = chk_fileconflicts(p1->files, p2->files);
-				for(k = ret; k; k = k->next) {
-						pmconflict_t *conflict = _pacman_malloc(sizeof(pmconflict_t));
-						if(conflict == NULL) {
-							continue;
-						}
-						conflict->type = PM_CONFLICT_TYPE_TARGET;
-						STRNCPY(conflict->target, p1->name, PKG_NAME_LEN);
-						STRNCPY(conflict->file, k->data, CONFLICT_FILE_LEN);
-						STRNCPY(conflict->ctarget, p2->name, PKG_NAME_LEN);
-						conflicts = _pacman_list_add(conflicts, conflict);
+
+		/* CHECK 1: check every target against the following targets */
+		for(j = p->files; j; j = j->next) {
+			pmfileowner_t *owner;
+			filestr = (char*)j->data;
+			/* skip directories, we don't care about dir conflicts */
+			if(filestr[0] == '\0' || _pacman_path_isdir(filestr)) {
+				continue;
+			}
+			if(j->prev && j->prev->data == j->data) {
+				/* listed twice */
+				continue;
+			}
+			if((owner = owners[_pacman_path_id(filestr)]) == NULL) {
+				continue;
+			}
+			for(k = owner->targets; k && k->data != target; k = k->next);
+			for(k = k ? k->next : NULL; k; k = k->next) {
+				pmfiletarget_t *other = k->data;
+				pmfileshare_t *share;
+				if(!strcmp(p->name, other->pkg->name)) {
+					continue;
+				}
+				if((share = _pacman_pool_alloc(pool, sizeof(pmfileshare_t))) != NULL) {
+					share->file = filestr;
+					share->target = other;
+					shares = _pacman_pool_list_add(pool, shares, share);
 				}
-				FREELIST(ret);
 			}
 		}
+		/* in the order of the other target, then of the file */
+		shares = _pacman_list_sort(shares, _pacman_fileshare_cmp);
+		for(j = shares; j; j = j->next) {
+			pmfileshare_t *share = j->data;
+			conflicts = _pacman_conflict_add_file(conflicts, PM_CONFLICT_TYPE_TARGET, p, share->file, share->target->pkg);
+		}
 
 		/* CHECK 2: check every target against the filesystem */
-		p = (pmpkg_t*)i->data;
-		dbpkg = NULL;
 		for(j = p->files; j; j = j->next) {
+			pmfileowner_t *owner;
+			int ok = 0;
 			filestr = (char*)j->data;
-			snprintf(path, PATH_MAX, "%s%s", root, filestr);
-			/* is this target a file or directory? */
-			if(path[strlen(path)-1] == '/') {
-				path[strlen(path)-1] = '\0';
+			owner = owners[_pacman_path_id(filestr)];
+			if(_pacman_fileowner_isold(owner, target)) {
+				/* not probed */
+				continue;
 			}
-			if(!lstat(path, &buf)) {
-				int ok = 0;
-				/* re-fetch with stat() instead of lstat() */
-				stat(path, &buf);
-				if(S_ISDIR(buf.st_mode)) {
-					/* if it's a directory, then we have no conflict */
+			if((probe++)->type != PM_PROBE_FILE) {
+				/* missing, or a directory: we have no conflict */
+				continue;
+			}
+			/* Check if the conflicting file has been moved to another package/target */
+			for(k = owner ? owner->olders : NULL; k && !ok; k = k->next) {
+				pmfiletarget_t *other = k->data;
+				/* If it used to exist in there, but doesn't anymore */
+				if(strcmp(other->pkg->name, p->name) && !_pacman_list_is_in(other, owner->targets)) {
 					ok = 1;
-				} else {
-					if(dbpkg == NULL) {
-						dbpkg = _pacman_db_get_pkgfromcache(db, p->name);
-					}
-					if(dbpkg && !(dbpkg->infolevel & INFRQ_FILES)) {
-						_pacman_log(PM_LOG_DEBUG, _("loading FILES info for '%s'"), dbpkg->name);
-						_pacman_db_read(db, INFRQ_FILES, dbpkg);
-					}
-					if(dbpkg && _pacman_list_is_strin(j->data, dbpkg->files)) {
-						ok = 1;
-					}
-					/* Check if the conflicting file has been moved to another package/target */
-					if(!ok) {
-						/* Look at all the targets */
-						for(k = targets; k && !ok; k = k->next) {
-							pmpkg_t *p2 = (pmpkg_t *)k->data;
-							/* As long as they're not the current package */
-							if(strcmp(p2->name, p->name)) {
-								pmpkg_t *dbpkg2 = NULL;
-								dbpkg2 = _pacman_db_get_pkgfromcache(db, p2->name);
-								if(dbpkg2 && !(dbpkg2->infolevel & INFRQ_FILES)) {
-									_pacman_log(PM_LOG_DEBUG, _("loading FILES info for '%s'"), dbpkg2->name);
-									_pacman_db_read(db, INFRQ_FILES, dbpkg2);
-								}
-								/* If it used to exist in there, but doesn't anymore */
-								if(dbpkg2 && !_pacman_list_is_strin(filestr, p2->files) && _pacman_list_is_strin(filestr, dbpkg2->files)) {
-									ok = 1;
-									/* Add to the "skip list" of files that we shouldn't remove during an upgrade.
-									 *
-									 * This is a workaround for the following scenario:
-									 *
-									 *    - the old package A provides file X
-									 *    - the new package A does not
-									 *    - the new package B provides file X
-									 *    - package A depends on B, so B is upgraded first
-									 *
-									 * Package B is upgraded, so file X is installed.  Then package A
-									 * is upgraded, and it *removes* file X, since it no longer exists
-									 * in package A.
-									 *
-									 * Our workaround is to scan through all "old" packages and all "new"
-									 * ones, looking for files that jump to different packages.
-									 */
-									*skip_list = _pacman_list_add(*skip_list, strdup(filestr));
-								}
-							}
-						}
-					}
-				}
-				if(!ok) {
-					pmconflict_t *conflict = _pacman_malloc(sizeof(pmconflict_t));
-					if(conflict == NULL) {
-						continue;
-					}
-					conflict->type = PM_CONFLICT_TYPE_FILE;
-					STRNCPY(conflict->target, p->name, PKG_NAME_LEN);
-					STRNCPY(conflict->file, filestr, CONFLICT_FILE_LEN);
-					conflict->ctarget[0] = 0;
-					conflicts = _pacman_list_add(conflicts, conflict);
+					/* Add to the "skip list" of files that we shouldn't remove during an upgrade.
+					 *
+					 * This is a workaround for the following scenario:
+					 *
+					 *    - the old package A provides file X
+					 *    - the new package A does not
+					 *    - the new package B provides file X
+					 *    - package A depends on B, so B is upgraded first
+					 *
+					 * Package B is upgraded, so file X is installed.  Then package A
+					 * is upgraded, and it *removes* file X, since it no longer exists
+					 * in package A.
+					 *
+					 * Our workaround is to scan through all "old" packages and all "new"
+					 * ones, looking for files that jump to different packages.
+					 */
+					*skip_list = _pacman_list_add(*skip_list, filestr);
 				}
 			}
+			if(!ok) {
+				conflicts = _pacman_conflict_add_file(conflicts, PM_CONFLICT_TYPE_FILE, p, filestr, NULL);
+			}
 		}
 	}
 
+	FREE(probes);
+	FREE(owners);
+	_pacman_pool_free(pool);
+	_FREEVECTOR(vector, NULL);
 	return(conflicts);
 }
 
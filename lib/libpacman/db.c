@@ -68,8 +68,14 @@ pmdb_t *_pacman_db_new(char *root, char* dbpath, const char *treename)
 	STRNCPY(db->treename, treename, PATH_MAX);
 
 	db->pkgcache = NULL;
+	db->pkghash = NULL;
+	db->provhash = NULL;
+	db->revhash = NULL;
+	db->pool = NULL;
 	db->grpcache = NULL;
 	db->servers = NULL;
+	db->snapshot = NULL;
+	db->handle = NULL;
 
 	return(db);
 }
@@ -42,10 +42,15 @@ typedef struct __pmdb_t {
 	char *path;
 	char treename[PATH_MAX];
 	void *handle;
-	pmlist_t *pkgcache;
-	pmlist_t *grpcache;
+	pmvector_t *pkgcache;
+	struct __pmhash_t *pkghash; /* name -> package of pkgcache */
+	struct __pmhash_t *provhash; /* provided name -> providers in pkgcache */
+	struct __pmhash_t *revhash; /* depended upon name -> dependers in pkgcache */
+	pmvector_t *grpcache;
 	pmlist_t *servers;
 	char lastupdate[16];
+	struct __pmsnapshot_t *snapshot;
+	struct __pmpool_t *pool; /* records of a package cache loaded in one go */
 } pmdb_t;
 
 pmdb_t *_pacman_db_new(char *root, char *dbpath, const char *treename);
@@ -62,6 +67,7 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq);
 int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info);
 int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq);
 int _pacman_db_remove(pmdb_t *db, pmpkg_t *info);
+unsigned long long _pacman_db_stamp(pmdb_t *db, const char *name, const char *version, unsigned int inforeq);
 int _pacman_db_getlastupdate(pmdb_t *db, char *ts);
 int _pacman_db_setlastupdate(pmdb_t *db, char *ts);
 pmdb_t *_pacman_db_register(const char *treename, pacman_cb_db_register callback);
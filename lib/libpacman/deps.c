@@ -41,20 +41,9 @@
 #include "deps.h"
 #include "versioncmp.h"
 #include "handle.h"
-
-static pmgraph_t *_pacman_graph_new(void)
-{
-	pmgraph_t *graph = _pacman_zalloc(sizeof(pmgraph_t));
-
-	return(graph);
-}
-
-static void _pacman_graph_free(void *data)
-{
-	pmgraph_t *graph = data;
-	FREELISTPTR(graph->children);
-	FREE(graph);
-}
+#include "hash.h"
+#include "trans.h"
+#include "pool.h"
 
 pmdepmissing_t *_pacman_depmiss_new(const char *target, unsigned char type, unsigned char depmod,
                                   const char *depname, const char *depversion)
@@ -84,8 +73,12 @@ int _pacman_depmiss_isin(pmdepmissing_t *needle, pmlist_t *haystack)
 
 	for(i = haystack; i; i = i->next) {
 		pmdepmissing_t *miss = i->data;
-		if(!memcmp(needle, miss, sizeof(pmdepmissing_t))
-		   && !memcmp(&needle->depend, &miss->depend, sizeof(pmdepend_t))) {
+		/* the strings are compared up to their end only: the rest of the
+		 * buffers is not initialized */
+		if(needle->type == miss->type && needle->depend.mod == miss->depend.mod
+		   && !strcmp(needle->target, miss->target)
+		   && !strcmp(needle->depend.name, miss->depend.name)
+		   && !strcmp(needle->depend.version, miss->depend.version)) {
 			return(1);
 		}
 	}
@@ -93,6 +86,28 @@ int _pacman_depmiss_isin(pmdepmissing_t *needle, pmlist_t *haystack)
 	return(0);
 }
 
+static int _pacman_intcmp(const void *p1, const void *p2)
+{
+	return(*(const int *)p1 - *(const int *)p2);
+}
+
+/* Indexes vertex under name, keeping the vertices in target order */
+static int _pacman_graph_index(pmhash_t *names, const char *name, pmgraph_t *vertex)
+{
+	pmlist_t *vertices = _pacman_hash_get(names, name);
+
+	if(vertices && vertices->last->data == vertex) {
+		/* a package providing its own name */
+		return(0);
+	}
+	return(_pacman_hash_add(names, name, _pacman_list_add(vertices, vertex)));
+}
+
+static void _pacman_graph_freelist(void *vertices)
+{
+	_pacman_list_free(vertices, NULL);
+}
+
 /* Re-order a list of target packages with respect to their dependencies.
  *
  * Example (PM_TRANS_TYPE_ADD):
@@ -105,17 +120,20 @@ int _pacman_depmiss_isin(pmdepmissing_t *needle, pmlist_t *haystack)
  * mode should be either PM_TRANS_TYPE_ADD or PM_TRANS_TYPE_REMOVE.  This
  * affects the dependency order sortbydeps() will use.
  *
+ * The packages depending on each other in a cycle are reported to the
+ * frontend with a PM_TRANS_EVT_DEPCYCLE event.
+ *
  * This function returns the new pmlist_t* target list.
  *
  */
-pmlist_t *_pacman_sortbydeps(pmlist_t *targets, int mode)
+pmlist_t *_pacman_sortbydeps(pmtrans_t *trans, pmlist_t *targets, int mode)
 {
 	pmlist_t *newtargs = NULL;
-	pmlist_t *i, *j, *k;
-	pmlist_t *vertices = NULL;
-	pmlist_t *vptr;
-	pmgraph_t *vertex;
-	int found;
+	pmlist_t *i, *j;
+	pmgraph_t *vertices, *vertex, *stack = NULL;
+	pmhash_t *names;
+	int *children;
+	int count, n, index = 0;
 
 	if(targets == NULL) {
 		return(NULL);
@@ -123,64 +141,119 @@ pmlist_t *_pacman_sortbydeps(pmlist_t *targets, int mode)
 
 	_pacman_log(PM_LOG_DEBUG, _("started sorting dependencies"));
 
-	/* We create the vertices */
-	for(i = targets; i; i = i->next) {
-		pmgraph_t *v = _pacman_graph_new();
-		v->data = (void *)i->data;
-		vertices = _pacman_list_add(vertices, v);
-	}
-
-	/* We compute the edges */
-	for(i = vertices; i; i = i->next) {
-		pmgraph_t *vertex_i = i->data;
-		pmpkg_t *p_i = vertex_i->data;
-		/* TODO this should be somehow combined with _pacman_checkdeps */
-		for(j = vertices; j; j = j->next) {
-			pmgraph_t *vertex_j = j->data;
-			pmpkg_t *p_j = vertex_j->data;
-			int child = 0;
-			for(k = _pacman_pkg_getinfo(p_i, PM_PKG_DEPENDS); k && !child; k = k->next) {
-				pmdepend_t depend;
-				_pacman_splitdep(k->data, &depend);
-				child = _pacman_depcmp(p_j, &depend);
-			}
-			if(child) {
-				vertex_i->children = _pacman_list_add(vertex_i->children, vertex_j);
+	count = _pacman_list_count(targets);
+	vertices = _pacman_zalloc(count * sizeof(pmgraph_t));
+	children = _pacman_malloc(count * sizeof(int));
+	names = _pacman_hash_new(count);
+	if(vertices == NULL || children == NULL || names == NULL) {
+		FREE(vertices);
+		FREE(children);
+		FREEHASH(names);
+		/* rather keep the targets unsorted than lose them */
+		for(i = targets; i; i = i->next) {
+			newtargs = _pacman_list_add(newtargs, i->data);
+		}
+		return(newtargs);
+	}
+
+	/* We create the vertices, indexed by the names they can satisfy */
+	for(i = targets, n = 0; i; i = i->next, n++) {
+		pmpkg_t *pkg = i->data;
+		vertices[n].data = pkg;
+		_pacman_graph_index(names, pkg->name, &vertices[n]);
+		for(j = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); j; j = j->next) {
+			_pacman_graph_index(names, j->data, &vertices[n]);
+		}
+	}
+
+	/* We compute the edges, looking up the candidates of each dependency
+	 * instead of trying every target */
+	for(n = 0; n < count; n++) {
+		pmgraph_t *vertex_i = &vertices[n];
+		pmdepcache_t *deps = _pacman_parsedeps(vertex_i->data);
+		int d, c, nchildren = 0;
+
+		for(d = 0; deps && d < deps->count; d++) {
+			for(i = _pacman_hash_get(names, deps->deps[d].name); i; i = i->next) {
+				pmgraph_t *vertex_j = i->data;
+				/* lowlink is free until the walk, it marks the children of vertex_i */
+				if(vertex_j->lowlink != n + 1 && _pacman_depcmp(vertex_j->data, &deps->deps[d])) {
+					vertex_j->lowlink = n + 1;
+					vertex_i->selfloop |= (vertex_j == vertex_i);
+					children[nchildren++] = vertex_j - vertices;
+				}
 			}
 		}
+		/* visit the children in target order */
+		qsort(children, nchildren, sizeof(int), _pacman_intcmp);
+		for(c = 0; c < nchildren; c++) {
+			vertex_i->children = _pacman_list_add(vertex_i->children, &vertices[children[c]]);
+		}
 		vertex_i->childptr = vertex_i->children;
 	}
+	for(n = 0; n < count; n++) {
+		vertices[n].lowlink = 0;
+	}
 
-	vptr = vertices;
-	vertex = vertices->data;
-	while(vptr) {
-		/* mark that we touched the vertex */
-		vertex->state = -1;
-		found = 0;
-		while(vertex->childptr && !found) {
-			pmgraph_t *nextchild = (vertex->childptr)->data;
-			vertex->childptr = (vertex->childptr)->next;
-			if (nextchild->state == 0) {
-				found = 1;
-				nextchild->parent = vertex;
-				vertex = nextchild;
-			} else if(nextchild->state == -1) {
-				_pacman_log(PM_LOG_DEBUG, _("dependency cycle detected"));
-			}
+	/* A depth first walk outputs the dependencies first; it keeps the
+	 * lowlinks of Tarjan's algorithm to find the strongly connected components
+	 * of the graph, ie the dependency cycles. */
+	for(n = 0; n < count; n++) {
+		if(vertices[n].index != 0) {
+			continue;
 		}
-		if(!found) {
+		vertex = &vertices[n];
+		vertex->index = vertex->lowlink = ++index;
+		vertex->next = stack;
+		vertex->onstack = 1;
+		stack = vertex;
+		while(vertex) {
+			int found = 0;
+			while(vertex->childptr && !found) {
+				pmgraph_t *nextchild = (vertex->childptr)->data;
+				vertex->childptr = (vertex->childptr)->next;
+				if(nextchild->index == 0) {
+					found = 1;
+					nextchild->parent = vertex;
+					vertex = nextchild;
+					vertex->index = vertex->lowlink = ++index;
+					vertex->next = stack;
+					vertex->onstack = 1;
+					stack = vertex;
+				} else if(nextchild->onstack) {
+					if(nextchild->index < vertex->lowlink) {
+						vertex->lowlink = nextchild->index;
+					}
+				}
+			}
+			if(found) {
+				continue;
+			}
 			newtargs = _pacman_list_add(newtargs, vertex->data);
-			/* mark that we've left this vertex */
-			vertex->state = 1;
-			vertex = vertex->parent;
-			if(!vertex) {
-				vptr = vptr->next;
-				while(vptr) {
-					vertex = vptr->data;
-					if (vertex->state == 0) break;
-					vptr = vptr->next;
+			if(vertex->lowlink == vertex->index) {
+				/* vertex is the root of a component: pop it */
+				pmlist_t *cycle = NULL;
+				pmgraph_t *v;
+				do {
+					v = stack;
+					stack = v->next;
+					v->onstack = 0;
+					cycle = _pacman_list_add(cycle, v->data);
+				} while(v != vertex);
+				if(cycle->next || vertex->selfloop) {
+					pmlist_t *sorted = _pacman_list_reverse(cycle);
+					for(i = sorted; i; i = i->next) {
+						_pacman_log(PM_LOG_DEBUG, _("dependency cycle detected: %s"), ((pmpkg_t *)i->data)->name);
+					}
+					EVENT(trans, PM_TRANS_EVT_DEPCYCLE, sorted, NULL);
+					FREELISTPTR(sorted);
 				}
+				FREELISTPTR(cycle);
+			}
+			if(vertex->parent && vertex->lowlink < vertex->parent->lowlink) {
+				vertex->parent->lowlink = vertex->lowlink;
 			}
+			vertex = vertex->parent;
 		}
 	}
 	_pacman_log(PM_LOG_DEBUG, _("sorting dependencies finished"));
@@ -193,7 +266,12 @@ pmlist_t *_pacman_sortbydeps(pmlist_t *targets, int mode)
 		newtargs = tmptargs;
 	}
 
-	_FREELIST(vertices, _pacman_graph_free);
+	for(n = 0; n < count; n++) {
+		FREELISTPTR(vertices[n].children);
+	}
+	FREE(vertices);
+	FREE(children);
+	_FREEHASH(names, _pacman_graph_freelist);
 
 	return(newtargs);
 }
@@ -205,9 +283,10 @@ pmlist_t *_pacman_sortbydeps(pmlist_t *targets, int mode)
  */
 pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmlist_t *packages)
 {
-	pmdepend_t depend;
+	pmdepcache_t *deps;
+	const pmdepcons_t *depend;
 	pmlist_t *i, *j, *k;
-	int cmp;
+	int cmp, n;
 	int found = 0;
 	pmlist_t *baddeps = NULL;
 	pmdepmissing_t *miss = NULL;
@@ -242,14 +321,15 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
 					/* this package is also in the upgrade list, so don't worry about it */
 					continue;
 				}
-				for(k = _pacman_pkg_getinfo(p, PM_PKG_DEPENDS); k; k = k->next) {
+				deps = _pacman_parsedeps(p);
+				for(n = 0; deps && n < deps->count; n++) {
 					/* don't break any existing dependencies (possible provides) */
-					_pacman_splitdep(k->data, &depend);
-					if(_pacman_depcmp(oldpkg, &depend) && !_pacman_depcmp(tp, &depend)) {
+					depend = &deps->deps[n];
+					if(_pacman_depcmp(oldpkg, depend) && !_pacman_depcmp(tp, depend)) {
 						_pacman_log(PM_LOG_DEBUG, _("checkdeps: updated '%s' won't satisfy a dependency of '%s'"),
 								oldpkg->name, p->name);
-						miss = _pacman_depmiss_new(p->name, PM_DEP_TYPE_DEPEND, depend.mod,
-								depend.name, depend.version);
+						miss = _pacman_depmiss_new(p->name, PM_DEP_TYPE_DEPEND, depend->mod,
+								depend->name, depend->version);
 						if(!_pacman_depmiss_isin(miss, baddeps)) {
 							baddeps = _pacman_list_add(baddeps, miss);
 						} else {
@@ -268,43 +348,32 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
 				continue;
 			}
 
-			for(j = _pacman_pkg_getinfo(tp, PM_PKG_DEPENDS); j; j = j->next) {
-				/* split into name/version pairs */
-				_pacman_splitdep((char *)j->data, &depend);
+			deps = _pacman_parsedeps(tp);
+			for(n = 0; deps && n < deps->count; n++) {
+				depend = &deps->deps[n];
 				found = 0;
 				/* check database for literal packages */
-				for(k = _pacman_db_get_pkgcache(db); k && !found; k = k->next) {
-					pmpkg_t *p = (pmpkg_t *)k->data;
-					if(!strcmp(p->name, depend.name)) {
-						if(depend.mod == PM_DEP_MOD_ANY) {
-							/* accept any version */
-							found = 1;
-						} else {
-							char *ver = strdup(p->version);
-							/* check for a release in depend.version.  if it's
-							 * missing remove it from p->version as well.
-							 */
-							if(!index(depend.version,'-')) {
-								char *ptr;
-								for(ptr = ver; *ptr != '-'; ptr++);
-								*ptr = '\0';
-							}
-							cmp = _pacman_versioncmp(ver, depend.version);
-							switch(depend.mod) {
-								case PM_DEP_MOD_EQ: found = (cmp == 0); break;
-								case PM_DEP_MOD_GE: found = (cmp >= 0); break;
-								case PM_DEP_MOD_LE: found = (cmp <= 0); break;
-								case PM_DEP_MOD_LT: found = (cmp < 0); break;
-								case PM_DEP_MOD_GT: found = (cmp > 0); break;
-							}
-							FREE(ver);
+				pmpkg_t *p = _pacman_db_get_pkgfromcache(db, depend->name);
+				if(p != NULL) {
+					if(depend->mod == PM_DEP_MOD_ANY) {
+						/* accept any version */
+						found = 1;
+					} else {
+						/* the release of p->version is only compared when depend->version has one */
+						cmp = _pacman_pkg_vercmpkey(p, depend->verkey);
+						switch(depend->mod) {
+							case PM_DEP_MOD_EQ: found = (cmp == 0); break;
+							case PM_DEP_MOD_GE: found = (cmp >= 0); break;
+							case PM_DEP_MOD_LE: found = (cmp <= 0); break;
+							case PM_DEP_MOD_LT: found = (cmp < 0); break;
+							case PM_DEP_MOD_GT: found = (cmp > 0); break;
 						}
 					}
 				}
  				/* check database for provides matches */
  				if(!found) {
  					pmlist_t *m;
- 					k = _pacman_db_whatprovides(db, depend.name);
+ 					k = _pacman_db_whatprovides(db, depend->name);
  					for(m = k; m && !found; m = m->next) {
  						/* look for a match that isn't one of the packages we're trying
  						 * to install.  this way, if we match against a to-be-installed
@@ -323,28 +392,19 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
  							continue;
  						}
 
-						if(depend.mod == PM_DEP_MOD_ANY) {
+						if(depend->mod == PM_DEP_MOD_ANY) {
 							/* accept any version */
 							found = 1;
 						} else {
-							char *ver = strdup(p->version);
-							/* check for a release in depend.version.  if it's
-							 * missing remove it from p->version as well.
-							 */
-							if(!index(depend.version,'-')) {
-								char *ptr;
-								for(ptr = ver; *ptr != '-'; ptr++);
-								*ptr = '\0';
-							}
-							cmp = _pacman_versioncmp(ver, depend.version);
-							switch(depend.mod) {
+							/* the release of p->version is only compared when depend->version has one */
+							cmp = _pacman_pkg_vercmpkey(p, depend->verkey);
+							switch(depend->mod) {
 								case PM_DEP_MOD_EQ: found = (cmp == 0); break;
 								case PM_DEP_MOD_GE: found = (cmp >= 0); break;
 								case PM_DEP_MOD_LE: found = (cmp <= 0); break;
 								case PM_DEP_MOD_LT: found = (cmp < 0); break;
 								case PM_DEP_MOD_GT: found = (cmp > 0); break;
 							}
-							FREE(ver);
 						}
 					}
 					FREELISTPTR(k);
@@ -352,40 +412,31 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
  				/* check other targets */
  				for(k = packages; k && !found; k = k->next) {
  					pmpkg_t *p = (pmpkg_t *)k->data;
- 					/* see if the package names match OR if p provides depend.name */
- 					if(!strcmp(p->name, depend.name) || _pacman_list_is_strin(depend.name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
-						if(depend.mod == PM_DEP_MOD_ANY ||
-								_pacman_list_is_strin(depend.name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
+ 					/* see if the package names match OR if p provides depend->name */
+ 					if(!strcmp(p->name, depend->name) || _pacman_list_is_strin(depend->name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
+						if(depend->mod == PM_DEP_MOD_ANY ||
+								_pacman_list_is_strin(depend->name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
 							/* depend accepts any version or p provides depend (provides - by
 							 * definition - is for all versions) */
 							found = 1;
 						} else {
-							char *ver = strdup(p->version);
-							/* check for a release in depend.version.  if it's
-							 * missing remove it from p->version as well.
-							 */
-							if(!index(depend.version,'-')) {
-								char *ptr;
-								for(ptr = ver; *ptr != '-'; ptr++);
-								*ptr = '\0';
-							}
-							cmp = _pacman_versioncmp(ver, depend.version);
-							switch(depend.mod) {
+							/* the release of p->version is only compared when depend->version has one */
+							cmp = _pacman_pkg_vercmpkey(p, depend->verkey);
+							switch(depend->mod) {
 								case PM_DEP_MOD_EQ: found = (cmp == 0); break;
 								case PM_DEP_MOD_GE: found = (cmp >= 0); break;
 								case PM_DEP_MOD_LE: found = (cmp <= 0); break;
 								case PM_DEP_MOD_LT: found = (cmp < 0); break;
 								case PM_DEP_MOD_GT: found = (cmp > 0); break;
 							}
-							FREE(ver);
 						}
 					}
 				}
 				/* else if still not found... */
 				if(!found) {
 					_pacman_log(PM_LOG_DEBUG, _("checkdeps: found %s as a dependency for %s"),
-					          depend.name, tp->name);
-					miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_DEPEND, depend.mod, depend.name, depend.version);
+					          depend->name, tp->name);
+					miss = _pacman_depmiss_new(tp->name, PM_DEP_TYPE_DEPEND, depend->mod, depend->name, depend->version);
 					if(!_pacman_depmiss_isin(miss, baddeps)) {
 						baddeps = _pacman_list_add(baddeps, miss);
 					} else {
@@ -404,7 +455,7 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
 
 			found=0;
 			for(j = _pacman_pkg_getinfo(tp, PM_PKG_REQUIREDBY); j; j = j->next) {
-				if(!_pacman_list_is_strin((char *)j->data, packages)) {
+				if(!_pacman_pkg_isin((char *)j->data, packages)) {
 					/* check if a package in trans->packages provides this package */
 					for(k=trans->packages; !found && k; k=k->next) {
 						pmpkg_t *spkg = NULL;
@@ -435,252 +486,589 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
 	return(baddeps);
 }
 
-int _pacman_splitdep(char *depstr, pmdepend_t *depend)
+/* Splits depstr into its name, version and operator, copying the name, the
+ * version and its key (see _pacman_verkey()) in buf.
+ * Returns the number of bytes used in buf, or needed if buf is NULL.
+ */
+static size_t _pacman_splitdep(const char *depstr, pmdepcons_t *dep, char *buf)
 {
-	char *str = NULL;
-	char *ptr = NULL;
+	char tmp[PM_VERKEY_MAX];
+	const char *ptr, *version = "";
+	size_t len, size;
 
-	if(depstr == NULL || depend == NULL) {
-		return(-1);
+	dep->str = depstr;
+	if((ptr = strstr(depstr, ">="))) {
+		dep->mod = PM_DEP_MOD_GE;
+	} else if((ptr = strstr(depstr, "<="))) {
+		dep->mod = PM_DEP_MOD_LE;
+	} else if((ptr = strstr(depstr, "="))) {
+		dep->mod = PM_DEP_MOD_EQ;
+	} else if((ptr = strstr(depstr, "<"))) {
+		dep->mod = PM_DEP_MOD_LT;
+	} else if((ptr = strstr(depstr, ">"))) {
+		dep->mod = PM_DEP_MOD_GT;
+	} else {
+		/* no version specified - accept any */
+		dep->mod = PM_DEP_MOD_ANY;
 	}
 
-	depend->mod = 0;
-	depend->name[0] = 0;
-	depend->version[0] = 0;
+	len = ptr ? (size_t)(ptr - depstr) : strlen(depstr);
+	if(ptr != NULL) {
+		version = ptr + ((dep->mod == PM_DEP_MOD_GE || dep->mod == PM_DEP_MOD_LE) ? 2 : 1);
+	}
+	size = len + 1 + strlen(version) + 1;
 
-	str = strdup(depstr);
+	if(buf == NULL) {
+		return(size + (ptr ? _pacman_verkey(version, tmp) : 0));
+	}
 
-	if((ptr = strstr(str, ">="))) {
-		depend->mod = PM_DEP_MOD_GE;
-	} else if((ptr = strstr(str, "<="))) {
-		depend->mod = PM_DEP_MOD_LE;
-	} else if((ptr = strstr(str, "="))) {
-		depend->mod = PM_DEP_MOD_EQ;
-	} else if((ptr = strstr(str, "<"))) {
-		depend->mod = PM_DEP_MOD_LT;
-	} else if((ptr = strstr(str, ">"))) {
-		depend->mod = PM_DEP_MOD_GT;
-	} else {
-		/* no version specified - accept any */
-		depend->mod = PM_DEP_MOD_ANY;
-		STRNCPY(depend->name, str, PKG_NAME_LEN);
+	memcpy(buf, depstr, len);
+	buf[len] = '\0';
+	dep->name = buf;
+	strcpy(buf + len + 1, version);
+	dep->version = buf + len + 1;
+	dep->verkey = NULL;
+	if(ptr != NULL) {
+		dep->verkey = buf + size;
+		size += _pacman_verkey(version, buf + size);
 	}
 
-	if(ptr == NULL) {
-		FREE(str);
-		return(0);
+	return(size);
+}
+
+/* Returns the depends of pkg split into name/version pairs.  They are parsed
+ * once and kept in pkg->depcache, for as long as the depends list holds the
+ * same strings; whoever modifies a string in place must free the cache.
+ */
+pmdepcache_t *_pacman_parsedeps(pmpkg_t *pkg)
+{
+	pmlist_t *depends = _pacman_pkg_getinfo(pkg, PM_PKG_DEPENDS);
+	pmdepcache_t *cache = pkg->depcache;
+	pmdepcons_t dep;
+	pmlist_t *i;
+	size_t size;
+	char *buf;
+	int n;
+
+	if(cache != NULL) {
+		for(i = depends, n = 0; i && n < cache->count && cache->deps[n].str == i->data; i = i->next, n++);
+		if(i == NULL && n == cache->count) {
+			return(cache);
+		}
+		FREE(pkg->depcache);
+	}
+
+	size = sizeof(pmdepcache_t);
+	for(i = depends, n = 0; i; i = i->next, n++) {
+		size += sizeof(pmdepcons_t) + _pacman_splitdep(i->data, &dep, NULL);
+	}
+	if((cache = _pacman_malloc(size)) == NULL) {
+		return(NULL);
 	}
-	*ptr = '\0';
-	STRNCPY(depend->name, str, PKG_NAME_LEN);
-	ptr++;
-	if(depend->mod == PM_DEP_MOD_GE || depend->mod == PM_DEP_MOD_LE) {
-		ptr++;
+	cache->count = n;
+	buf = (char *)&cache->deps[n];
+	for(i = depends, n = 0; i; i = i->next, n++) {
+		buf += _pacman_splitdep(i->data, &cache->deps[n], buf);
 	}
-	STRNCPY(depend->version, ptr, PKG_VERSION_LEN);
-	FREE(str);
 
+	pkg->depcache = cache;
+	return(cache);
+}
+
+/* A dependency of the removal targets, candidate to be removed with them */
+typedef struct __pmremovenode_t {
+	pmpkg_t *pkg; /* in the cache of the database */
+	int missing; /* packages requiring it which are not targets, -1 if explicit */
+	int pos, dep; /* first reference to it: dependency dep of the pos-th target */
+} pmremovenode_t;
+
+/* The state of _pacman_removedeps() and _pacman_cascadedeps() */
+typedef struct __pmremover_t {
+	pmdb_t *db;
+	pmhash_t *targets; /* names of the targets */
+	pmhash_t *nodes; /* names of the candidates to their node */
+	pmhash_t *waiters; /* names required by candidates to the list of these */
+	pmhash_t *provided; /* names provided by the targets */
+	pmlist_t *ready; /* candidates not needed anymore, by first reference */
+	pmpool_t *pool; /* nodes and lists of waiters */
+} pmremover_t;
+
+static int _pacman_remover_init(pmremover_t *remover, pmdb_t *db)
+{
+	memset(remover, 0, sizeof(pmremover_t));
+	remover->db = db;
+	remover->targets = _pacman_hash_new(0);
+	remover->nodes = _pacman_hash_new(0);
+	remover->waiters = _pacman_hash_new(0);
+	remover->provided = _pacman_hash_new(0);
+	remover->pool = _pacman_pool_new(0);
+	if(!remover->targets || !remover->nodes || !remover->waiters || !remover->provided || !remover->pool) {
+		return(-1);
+	}
 	return(0);
 }
 
+static void _pacman_remover_fini(pmremover_t *remover)
+{
+	FREEHASH(remover->targets);
+	FREEHASH(remover->nodes);
+	FREEHASH(remover->waiters);
+	FREEHASH(remover->provided);
+	FREELISTPTR(remover->ready);
+	if(remover->pool) {
+		_pacman_pool_free(remover->pool);
+		remover->pool = NULL;
+	}
+}
+
+static int _pacman_removenode_cmp(const void *n1, const void *n2)
+{
+	const pmremovenode_t *node1 = n1, *node2 = n2;
+
+	if(node1->pos != node2->pos) {
+		return(node1->pos - node2->pos);
+	}
+	return(node1->dep - node2->dep);
+}
+
+/* Looks for the candidates among the dependencies of pkg, the pos-th target.
+ */
+static void _pacman_remover_visit(pmremover_t *remover, pmpkg_t *pkg, int pos)
+{
+	pmdepcache_t *deps = _pacman_parsedeps(pkg);
+	int n;
+
+	for(n = 0; deps && n < deps->count; n++) {
+		const pmdepcons_t *depend = &deps->deps[n];
+		pmremovenode_t *node;
+		pmpkg_t *dep;
+		pmlist_t *k;
+
+		dep = _pacman_db_get_pkgfromcache(remover->db, depend->name);
+		if(dep == NULL) {
+			/* package not found... look for a provisio instead */
+			k = _pacman_db_whatprovides(remover->db, depend->name);
+			if(k == NULL) {
+				_pacman_log(PM_LOG_WARNING, _("cannot find package \"%s\" or anything that provides it!"), depend->name);
+				continue;
+			}
+			dep = _pacman_db_get_pkgfromcache(remover->db, ((pmpkg_t *)k->data)->name);
+			FREELISTPTR(k);
+			if(dep == NULL) {
+				_pacman_log(PM_LOG_ERROR, _("dep is NULL!"));
+				/* wtf */
+				continue;
+			}
+		}
+		if(_pacman_hash_get(remover->targets, dep->name) || _pacman_hash_get(remover->nodes, dep->name)) {
+			continue;
+		}
+
+		if((node = _pacman_pool_alloc(remover->pool, sizeof(pmremovenode_t))) == NULL) {
+			continue;
+		}
+		node->pkg = dep;
+		node->missing = 0;
+		node->pos = pos;
+		node->dep = n;
+		_pacman_hash_add(remover->nodes, dep->name, node);
+
+		/* see if it was explicitly installed */
+		if(dep->reason == PM_PKG_REASON_EXPLICIT) {
+			_pacman_log(PM_LOG_FLOW2, _("excluding %s -- explicitly installed"), dep->name);
+			node->missing = -1;
+			continue;
+		}
+
+		/* wait for the other packages needing it */
+		for(k = _pacman_pkg_getinfo(dep, PM_PKG_REQUIREDBY); k; k = k->next) {
+			pmlist_t *waiters;
+			if(_pacman_hash_get(remover->targets, k->data)) {
+				continue;
+			}
+			node->missing++;
+			waiters = _pacman_hash_get(remover->waiters, k->data);
+			if(waiters == NULL) {
+				_pacman_hash_add(remover->waiters, k->data, _pacman_pool_list_add(remover->pool, NULL, node));
+			} else {
+				_pacman_pool_list_add(remover->pool, waiters, node);
+			}
+		}
+		if(node->missing == 0) {
+			remover->ready = _pacman_list_add_sorted(remover->ready, node, _pacman_removenode_cmp);
+		}
+	}
+}
+
+/* Marks pkg as a target, releasing the candidates it was needing.
+ */
+static void _pacman_remover_target(pmremover_t *remover, pmpkg_t *pkg)
+{
+	pmlist_t *i;
+
+	_pacman_hash_add(remover->targets, pkg->name, pkg);
+	for(i = _pacman_hash_remove(remover->waiters, pkg->name); i; i = i->next) {
+		pmremovenode_t *node = i->data;
+		if(--node->missing == 0) {
+			remover->ready = _pacman_list_add_sorted(remover->ready, node, _pacman_removenode_cmp);
+		}
+	}
+}
+
 /* return a new pmlist_t target list containing all packages in the original
  * target list, as well as all their un-needed dependencies.  By un-needed,
  * I mean dependencies that are *only* required for packages in the target
- * list, so they can be safely removed.  This function is recursive.
+ * list, so they can be safely removed.
+ *
+ * Every dependency of a target is marked once with the count of packages
+ * requiring it which are not targets, and is swept into the targets when
+ * this count drops to zero.  The first dependency referenced is swept first,
+ * as the former recursive scan of the whole list did.
  */
 pmlist_t *_pacman_removedeps(pmdb_t *db, pmlist_t *targs)
 {
-	pmlist_t *i, *j, *k;
-	pmlist_t *newtargs = targs;
+	pmremover_t remover;
+	pmlist_t *i;
+	int pos = 0;
 
 	if(db == NULL) {
-		return(newtargs);
+		return(targs);
 	}
 
+	if(_pacman_remover_init(&remover, db) == -1) {
+		_pacman_remover_fini(&remover);
+		return(targs);
+	}
+	for(i = targs; i; i = i->next) {
+		_pacman_remover_target(&remover, i->data);
+	}
 	for(i = targs; i; i = i->next) {
-		for(j = (_pacman_pkg_getinfo((pmpkg_t *)i->data, PM_PKG_DEPENDS)); j; j = j->next) {
-			pmdepend_t depend;
-			pmpkg_t *dep;
-			int needed = 0;
+		_pacman_remover_visit(&remover, i->data, pos++);
+	}
 
-			if(_pacman_splitdep(j->data, &depend)) {
-				continue;
-			}
+	while(remover.ready) {
+		pmremovenode_t *node = remover.ready->data;
+		pmpkg_t *pkg;
 
-			dep = _pacman_db_get_pkgfromcache(db, depend.name);
-			if(dep == NULL) {
-				/* package not found... look for a provisio instead */
-				k = _pacman_db_whatprovides(db, depend.name);
-				if(k == NULL) {
-					_pacman_log(PM_LOG_WARNING, _("cannot find package \"%s\" or anything that provides it!"), depend.name);
-					continue;
-				}
-				dep = _pacman_db_get_pkgfromcache(db, ((pmpkg_t *)k->data)->name);
-				if(dep == NULL) {
-					_pacman_log(PM_LOG_ERROR, _("dep is NULL!"));
-					/* wtf */
-					continue;
-				}
-				FREELISTPTR(k);
-			}
-			if(_pacman_pkg_isin(dep->name, targs)) {
-				continue;
-			}
+		remover.ready = _pacman_list_remove(remover.ready, node, _pacman_removenode_cmp, NULL);
+		if((pkg = _pacman_pkg_new(node->pkg->name, node->pkg->version)) == NULL) {
+			continue;
+		}
+		/* add it to the target list */
+		_pacman_log(PM_LOG_DEBUG, _("loading ALL info for '%s'"), pkg->name);
+		_pacman_db_read(db, INFRQ_ALL, pkg);
+		targs = _pacman_list_add(targs, pkg);
+		_pacman_log(PM_LOG_FLOW2, _("adding '%s' to the targets"), pkg->name);
+		_pacman_remover_target(&remover, pkg);
+		_pacman_remover_visit(&remover, pkg, pos++);
+	}
 
-			/* see if it was explicitly installed */
-			if(dep->reason == PM_PKG_REASON_EXPLICIT) {
-				_pacman_log(PM_LOG_FLOW2, _("excluding %s -- explicitly installed"), dep->name);
-				needed = 1;
-			}
+	_pacman_remover_fini(&remover);
+	return(targs);
+}
+
+static void _pacman_remover_provide(pmremover_t *remover, pmpkg_t *pkg)
+{
+	pmlist_t *i;
 
-			/* see if other packages need it */
-			for(k = _pacman_pkg_getinfo(dep, PM_PKG_REQUIREDBY); k && !needed; k = k->next) {
-				pmpkg_t *dummy = _pacman_db_get_pkgfromcache(db, k->data);
-				if(!_pacman_pkg_isin(dummy->name, targs)) {
-					needed = 1;
+	for(i = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); i; i = i->next) {
+		if(_pacman_hash_get(remover->provided, i->data) == NULL) {
+			_pacman_hash_add(remover->provided, i->data, pkg);
+		}
+	}
+}
+
+/* return the target list with all the packages requiring its packages
+ * (recursive) appended, unless a target provides the required package.
+ *
+ * The packages are pulled by rounds, as the former loop over
+ * _pacman_checkdeps() did, but each target is only checked once: the
+ * packages requiring it are targets after its round.
+ */
+pmlist_t *_pacman_cascadedeps(pmdb_t *db, pmlist_t *targs)
+{
+	pmremover_t remover;
+	pmlist_t *i, *round, *pulled;
+
+	if(db == NULL || targs == NULL) {
+		return(targs);
+	}
+
+	if(_pacman_remover_init(&remover, db) == -1) {
+		_pacman_remover_fini(&remover);
+		return(targs);
+	}
+	for(i = targs; i; i = i->next) {
+		_pacman_remover_target(&remover, i->data);
+		_pacman_remover_provide(&remover, i->data);
+	}
+
+	for(round = targs; round; round = pulled) {
+		pmlist_t *last = targs->last;
+
+		pulled = NULL;
+		for(i = round; i; i = i->next) {
+			pmpkg_t *tp = i->data;
+			pmlist_t *j;
+
+			if(tp != NULL && _pacman_hash_get(remover.provided, tp->name) == NULL) {
+				for(j = _pacman_pkg_getinfo(tp, PM_PKG_REQUIREDBY); j; j = j->next) {
+					pmpkg_t *info;
+					if(_pacman_hash_get(remover.targets, j->data)) {
+						continue;
+					}
+					if((info = _pacman_db_scan(db, j->data, INFRQ_ALL)) == NULL) {
+						_pacman_log(PM_LOG_ERROR, _("could not find %s in database -- skipping"), (char *)j->data);
+						continue;
+					}
+					_pacman_log(PM_LOG_FLOW2, _("pulling %s in the targets list"), info->name);
+					targs = _pacman_list_add(targs, info);
+					_pacman_remover_target(&remover, info);
+					if(pulled == NULL) {
+						pulled = targs->last;
+					}
 				}
 			}
-			if(!needed) {
-				pmpkg_t *pkg = _pacman_pkg_new(dep->name, dep->version);
-				if(pkg == NULL) {
-					continue;
-				}
-				/* add it to the target list */
-				_pacman_log(PM_LOG_DEBUG, _("loading ALL info for '%s'"), pkg->name);
-				_pacman_db_read(db, INFRQ_ALL, pkg);
-				newtargs = _pacman_list_add(newtargs, pkg);
-				_pacman_log(PM_LOG_FLOW2, _("adding '%s' to the targets"), pkg->name);
-				newtargs = _pacman_removedeps(db, newtargs);
+			if(i == last) {
+				break;
 			}
 		}
+		/* the packages pulled by this round do not provide anything to it */
+		for(i = pulled; i; i = i->next) {
+			_pacman_remover_provide(&remover, i->data);
+		}
 	}
 
-	return(newtargs);
+	_pacman_remover_fini(&remover);
+	return(targs);
 }
 
-/* populates *list with packages that need to be installed to satisfy all
- * dependencies (recursive) for syncpkg
+/* The state of _pacman_resolvedeps() */
+typedef struct __pmresolver_t {
+	pmhash_t *listed; /* names of the packages in list */
+	pmhash_t *provided; /* names provided by the packages in list, to their first provider */
+	pmhash_t *trail; /* names of the packages being or already resolved */
+	pmhash_t *found; /* dependency names to the package of dbs_sync satisfying them */
+	pmpool_t *pool; /* keys of found */
+} pmresolver_t;
+
+/* A package whose dependencies are being resolved */
+typedef struct __pmresolveframe_t {
+	pmpkg_t *pkg;
+	pmlist_t *deps; /* its missing dependencies */
+	pmlist_t *next; /* the next one to resolve */
+} pmresolveframe_t;
+
+static void _pacman_resolver_list(pmresolver_t *resolver, pmpkg_t *pkg)
+{
+	pmlist_t *i;
+
+	_pacman_hash_add(resolver->listed, pkg->name, pkg);
+	for(i = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); i; i = i->next) {
+		if(_pacman_hash_get(resolver->provided, i->data) == NULL) {
+			_pacman_hash_add(resolver->provided, i->data, pkg);
+		}
+	}
+}
+
+/* Finds the package of dbs_sync satisfying name: a literal match in the
+ * first database having one, then the first provider of the first database
+ * having some.
+ */
+static pmpkg_t *_pacman_resolver_find(pmresolver_t *resolver, pmlist_t *dbs_sync, const char *name)
+{
+	pmpkg_t *ps = _pacman_hash_get(resolver->found, name);
+	pmlist_t *j;
+
+	if(ps != NULL) {
+		return(ps);
+	}
+	/* check literals */
+	for(j = dbs_sync; !ps && j; j = j->next) {
+		ps = _pacman_db_get_pkgfromcache(j->data, name);
+	}
+	/* check provides */
+	for(j = dbs_sync; !ps && j; j = j->next) {
+		pmlist_t *provides;
+		provides = _pacman_db_whatprovides(j->data, name);
+		if(provides) {
+			ps = provides->data;
+		}
+		FREELISTPTR(provides);
+	}
+	if(ps != NULL) {
+		_pacman_hash_add(resolver->found, _pacman_pool_strdup(resolver->pool, name), ps);
+	}
+	return(ps);
+}
+
+static pmdepmissing_t *_pacman_depmiss_dup(pmdepmissing_t *miss)
+{
+	pmdepmissing_t *dup = _pacman_malloc(sizeof(pmdepmissing_t));
+
+	if(dup != NULL) {
+		*dup = *miss;
+	}
+	return(dup);
+}
+
+/* Appends to list the packages that need to be installed to satisfy all the
+ * dependencies (recursive) of the packages already in list.  The packages
+ * are resolved depth first from an explicit stack, a dependency coming in
+ * list before the packages needing it.
  *
- * make sure *list and *trail are already initialized
+ * list must not be empty, it is modified in place.
  */
-int _pacman_resolvedeps(pmdb_t *local, pmlist_t *dbs_sync, pmpkg_t *syncpkg, pmlist_t *list,
-                      pmlist_t *trail, pmtrans_t *trans, pmlist_t **data)
+int _pacman_resolvedeps(pmdb_t *local, pmlist_t *dbs_sync, pmlist_t *list, pmtrans_t *trans, pmlist_t **data)
 {
-	pmlist_t *i, *j;
-	pmlist_t *targ;
-	pmlist_t *deps = NULL;
+	pmresolver_t resolver;
+	pmresolveframe_t *stack = NULL;
+	pmlist_t *i, *targ;
+	int count, depth = 0, size = 0, n, ret = -1;
 
-	if(local == NULL || dbs_sync == NULL || syncpkg == NULL) {
+	if(local == NULL || dbs_sync == NULL || list == NULL) {
 		return(-1);
 	}
 
-	targ = _pacman_list_add(NULL, syncpkg);
-	deps = _pacman_checkdeps(trans, local, PM_TRANS_TYPE_ADD, targ);
-	FREELISTPTR(targ);
+	resolver.listed = _pacman_hash_new(0);
+	resolver.provided = _pacman_hash_new(0);
+	resolver.trail = _pacman_hash_new(0);
+	resolver.found = _pacman_hash_new(0);
+	resolver.pool = _pacman_pool_new(0);
+	if(!resolver.listed || !resolver.provided || !resolver.trail || !resolver.found || !resolver.pool) {
+		goto cleanup;
+	}
 
-	if(deps == NULL) {
-		return(0);
+	count = _pacman_list_count(list);
+	for(i = list; i; i = i->next) {
+		_pacman_resolver_list(&resolver, i->data);
 	}
 
-	for(i = deps; i; i = i->next) {
-		int found = 0;
-		pmdepmissing_t *miss = i->data;
-		pmpkg_t *ps = NULL;
+	for(i = list, n = 0; n < count; i = i->next, n++) {
+		pmpkg_t *syncpkg = i->data;
+
+		/* push syncpkg */
+		if((stack = _pacman_malloc(sizeof(pmresolveframe_t))) == NULL) {
+			goto cleanup;
+		}
+		size = 1;
+		depth = 1;
+		targ = _pacman_list_add(NULL, syncpkg);
+		stack[0].pkg = syncpkg;
+		stack[0].deps = stack[0].next = _pacman_checkdeps(trans, local, PM_TRANS_TYPE_ADD, targ);
+		FREELISTPTR(targ);
 
-		/* check if one of the packages in *list already provides this dependency */
-		for(j = list; j && !found; j = j->next) {
-			pmpkg_t *sp = (pmpkg_t *)j->data;
-			if(_pacman_list_is_strin(miss->depend.name, _pacman_pkg_getinfo(sp, PM_PKG_PROVIDES))) {
+		while(depth > 0) {
+			pmresolveframe_t *frame = &stack[depth - 1];
+			pmdepmissing_t *miss;
+			pmpkg_t *ps, *sp;
+			int usedep = 1;
+
+			if(frame->next == NULL) {
+				/* all the dependencies of frame->pkg are in list: pop it */
+				ps = frame->pkg;
+				FREELIST(frame->deps);
+				if(--depth > 0) {
+					_pacman_log(PM_LOG_DEBUG, _("pulling dependency %s (needed by %s)"),
+					          ps->name, stack[depth - 1].pkg->name);
+					list = _pacman_list_add(list, ps);
+					_pacman_resolver_list(&resolver, ps);
+				}
+				continue;
+			}
+			miss = frame->next->data;
+			frame->next = frame->next->next;
+
+			/* check if one of the packages in *list already provides this dependency */
+			if((sp = _pacman_hash_get(resolver.provided, miss->depend.name)) != NULL) {
 				_pacman_log(PM_LOG_DEBUG, _("%s provides dependency %s -- skipping"),
 				          sp->name, miss->depend.name);
-				found = 1;
+				continue;
 			}
-		}
-		if(found) {
-			continue;
-		}
 
-		/* find the package in one of the repositories */
-		/* check literals */
-		for(j = dbs_sync; !ps && j; j = j->next) {
-			ps = _pacman_db_get_pkgfromcache(j->data, miss->depend.name);
-		}
-		/* check provides */
-		for(j = dbs_sync; !ps && j; j = j->next) {
-			pmlist_t *provides;
-			provides = _pacman_db_whatprovides(j->data, miss->depend.name);
-			if(provides) {
-				ps = provides->data;
-			}
-			FREELISTPTR(provides);
-		}
-		if(ps == NULL) {
-			_pacman_log(PM_LOG_ERROR, _("cannot resolve dependencies for \"%s\" (\"%s\" is not in the package set)"),
-			          miss->target, miss->depend.name);
-			if(data) {
-				if((miss = _pacman_malloc(sizeof(pmdepmissing_t))) == NULL) {
-					FREELIST(*data);
-					goto error;
+			/* find the package in one of the repositories */
+			if((ps = _pacman_resolver_find(&resolver, dbs_sync, miss->depend.name)) == NULL) {
+				_pacman_log(PM_LOG_ERROR, _("cannot resolve dependencies for \"%s\" (\"%s\" is not in the package set)"),
+				          miss->target, miss->depend.name);
+				if(data) {
+					if((miss = _pacman_depmiss_dup(miss)) == NULL) {
+						FREELIST(*data);
+						goto cleanup;
+					}
+					*data = _pacman_list_add(*data, miss);
 				}
-				*miss = *(pmdepmissing_t *)i->data;
-				*data = _pacman_list_add(*data, miss);
+				pm_errno = PM_ERR_UNSATISFIED_DEPS;
+				goto cleanup;
+			}
+			if(_pacman_hash_get(resolver.listed, ps->name)) {
+				/* this dep is already in the target list */
+				_pacman_log(PM_LOG_DEBUG, _("dependency %s is already in the target list -- skipping"),
+				          ps->name);
+				continue;
+			}
+			if(_pacman_hash_get(resolver.trail, ps->name)) {
+				/* cycle detected -- skip it */
+				_pacman_log(PM_LOG_DEBUG, _("dependency cycle detected: %s"), ps->name);
+				continue;
 			}
-			pm_errno = PM_ERR_UNSATISFIED_DEPS;
-			goto error;
-		}
-		if(_pacman_pkg_isin(ps->name, list)) {
-			/* this dep is already in the target list */
-			_pacman_log(PM_LOG_DEBUG, _("dependency %s is already in the target list -- skipping"),
-			          ps->name);
-			continue;
-		}
 
-		if(!_pacman_pkg_isin(ps->name, trail)) {
 			/* check pmo_ignorepkg and pmo_s_ignore to make sure we haven't pulled in
 			 * something we're not supposed to.
 			 */
-			int usedep = 1;
 			if(_pacman_list_is_strin(ps->name, handle->ignorepkg)) {
 				pmpkg_t *dummypkg = _pacman_pkg_new(miss->target, NULL);
 				QUESTION(trans, PM_TRANS_CONV_INSTALL_IGNOREPKG, dummypkg, ps, NULL, &usedep);
 				FREEPKG(dummypkg);
 			}
-			if(usedep) {
-				trail = _pacman_list_add(trail, ps);
-				if(_pacman_resolvedeps(local, dbs_sync, ps, list, trail, trans, data)) {
-					goto error;
-				}
-				_pacman_log(PM_LOG_DEBUG, _("pulling dependency %s (needed by %s)"),
-				          ps->name, syncpkg->name);
-				list = _pacman_list_add(list, ps);
-			} else {
+			if(!usedep) {
 				_pacman_log(PM_LOG_ERROR, _("cannot resolve dependencies for \"%s\""), miss->target);
 				if(data) {
-					if((miss = _pacman_malloc(sizeof(pmdepmissing_t))) == NULL) {
+					if((miss = _pacman_depmiss_dup(miss)) == NULL) {
 						FREELIST(*data);
-						goto error;
+						goto cleanup;
 					}
-					*miss = *(pmdepmissing_t *)i->data;
 					*data = _pacman_list_add(*data, miss);
 				}
 				pm_errno = PM_ERR_UNSATISFIED_DEPS;
-				goto error;
+				goto cleanup;
 			}
-		} else {
-			/* cycle detected -- skip it */
-			_pacman_log(PM_LOG_DEBUG, _("dependency cycle detected: %s"), ps->name);
+
+			/* push ps */
+			_pacman_hash_add(resolver.trail, ps->name, ps);
+			if(depth == size) {
+				pmresolveframe_t *tmp = realloc(stack, 2 * size * sizeof(pmresolveframe_t));
+				if(tmp == NULL) {
+					pm_errno = PM_ERR_MEMORY;
+					goto cleanup;
+				}
+				stack = tmp;
+				size *= 2;
+			}
+			targ = _pacman_list_add(NULL, ps);
+			stack[depth].pkg = ps;
+			stack[depth].deps = stack[depth].next = _pacman_checkdeps(trans, local, PM_TRANS_TYPE_ADD, targ);
+			FREELISTPTR(targ);
+			depth++;
 		}
+		FREE(stack);
 	}
+	ret = 0;
 
-	FREELIST(deps);
-
-	return(0);
-
-error:
-	FREELIST(deps);
-	return(-1);
+cleanup:
+	while(depth > 0) {
+		depth--;
+		FREELIST(stack[depth].deps);
+	}
+	FREE(stack);
+	FREEHASH(resolver.listed);
+	FREEHASH(resolver.provided);
+	FREEHASH(resolver.trail);
+	FREEHASH(resolver.found);
+	FREEPOOL(resolver.pool);
+	return(ret);
 }
 
-int _pacman_depcmp(pmpkg_t *pkg, pmdepend_t *dep)
+int _pacman_depcmp(pmpkg_t *pkg, const pmdepcons_t *dep)
 {
 	int equal = 0, cmp;
 	const char *mod = "~=";
@@ -690,7 +1078,7 @@ int _pacman_depcmp(pmpkg_t *pkg, pmdepend_t *dep)
 			if(dep->mod == PM_DEP_MOD_ANY) {
 				equal = 1;
 			} else {
-				cmp = _pacman_versioncmp(_pacman_pkg_getinfo(pkg, PM_PKG_VERSION), dep->version);
+				cmp = _pacman_pkg_vercmpkey(pkg, dep->verkey);
 				switch(dep->mod) {
 					case PM_DEP_MOD_EQ: equal = (cmp == 0); break;
 					case PM_DEP_MOD_GE: equal = (cmp >= 0); break;
@@ -701,25 +1089,28 @@ int _pacman_depcmp(pmpkg_t *pkg, pmdepend_t *dep)
 				}
 			}
 
-		switch(dep->mod) {
-			case PM_DEP_MOD_EQ: mod = "=="; break;
-			case PM_DEP_MOD_GE: mod = ">="; break;
-			case PM_DEP_MOD_LE: mod = "<="; break;
-			case PM_DEP_MOD_LT: mod = "<"; break;
-			case PM_DEP_MOD_GT: mod = ">"; break;
-			default: break;
-		}
+		/* only spend the lookups on the message when it is logged */
+		if(pm_logmask & PM_LOG_DEBUG) {
+			switch(dep->mod) {
+				case PM_DEP_MOD_EQ: mod = "=="; break;
+				case PM_DEP_MOD_GE: mod = ">="; break;
+				case PM_DEP_MOD_LE: mod = "<="; break;
+				case PM_DEP_MOD_LT: mod = "<"; break;
+				case PM_DEP_MOD_GT: mod = ">"; break;
+				default: break;
+			}
 
-		if(strlen(dep->version) > 0) {
-			_pacman_log(PM_LOG_DEBUG, _("depcmp: %s-%s %s %s-%s => %s"),
-								_pacman_pkg_getinfo(pkg, PM_PKG_NAME), _pacman_pkg_getinfo(pkg, PM_PKG_VERSION),
-								mod, dep->name, dep->version,
-								(equal ? "match" : "no match"));
-		} else {
-			_pacman_log(PM_LOG_DEBUG, _("depcmp: %s-%s %s %s => %s"),
-								_pacman_pkg_getinfo(pkg, PM_PKG_NAME), _pacman_pkg_getinfo(pkg, PM_PKG_VERSION),
-								mod, dep->name,
-								(equal ? "match" : "no match"));
+			if(dep->version[0] != '\0') {
+				_pacman_log(PM_LOG_DEBUG, _("depcmp: %s-%s %s %s-%s => %s"),
+									_pacman_pkg_getinfo(pkg, PM_PKG_NAME), _pacman_pkg_getinfo(pkg, PM_PKG_VERSION),
+									mod, dep->name, dep->version,
+									(equal ? "match" : "no match"));
+			} else {
+				_pacman_log(PM_LOG_DEBUG, _("depcmp: %s-%s %s %s => %s"),
+									_pacman_pkg_getinfo(pkg, PM_PKG_NAME), _pacman_pkg_getinfo(pkg, PM_PKG_VERSION),
+									mod, dep->name,
+									(equal ? "match" : "no match"));
+			}
 		}
 	}
 
@@ -32,6 +32,21 @@ typedef struct __pmdepend_t {
 	char version[PKG_VERSION_LEN];
 } pmdepend_t;
 
+/* A dependency of a package, see _pacman_parsedeps() */
+typedef struct __pmdepcons_t {
+	const char *str; /* the string of the depends list it was parsed from */
+	const char *name;
+	const char *version; /* "" if any version matches */
+	const char *verkey; /* the key of version, NULL if any version matches */
+	unsigned char mod;
+} pmdepcons_t;
+
+/* The parsed depends of a package: the strings point in the same block */
+typedef struct __pmdepcache_t {
+	int count;
+	pmdepcons_t deps[];
+} pmdepcache_t;
+
 typedef struct __pmdepmissing_t {
 	char target[PKG_NAME_LEN];
 	unsigned char type;
@@ -39,9 +54,13 @@ typedef struct __pmdepmissing_t {
 } pmdepmissing_t;
 
 typedef struct __pmgraph_t {
-	int state; /* 0: untouched, -1: entered, other: leaving time */
+	int index; /* 0: untouched, other: order of discovery */
+	int lowlink; /* smallest index reachable from the vertex, see _pacman_sortbydeps() */
+	int onstack;
+	int selfloop; /* the vertex depends on itself */
 	void *data;
 	struct __pmgraph_t *parent; /* where did we come from? */
+	struct __pmgraph_t *next; /* in the stack of the visited vertices */
 	pmlist_t *children;
 	pmlist_t *childptr; /* points to a child in children list */
 } pmgraph_t;
@@ -49,13 +68,13 @@ typedef struct __pmgraph_t {
 pmdepmissing_t *_pacman_depmiss_new(const char *target, unsigned char type, unsigned char depmod,
                             const char *depname, const char *depversion);
 int _pacman_depmiss_isin(pmdepmissing_t *needle, pmlist_t *haystack);
-pmlist_t *_pacman_sortbydeps(pmlist_t *targets, int mode);
+pmlist_t *_pacman_sortbydeps(pmtrans_t *trans, pmlist_t *targets, int mode);
 pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmlist_t *packages);
-int _pacman_splitdep(char *depstr, pmdepend_t *depend);
+pmdepcache_t *_pacman_parsedeps(pmpkg_t *pkg);
 pmlist_t *_pacman_removedeps(pmdb_t *db, pmlist_t *targs);
-int _pacman_resolvedeps(pmdb_t *local, pmlist_t *dbs_sync, pmpkg_t *syncpkg, pmlist_t *list,
-                pmlist_t *trail, pmtrans_t *trans, pmlist_t **data);
-int _pacman_depcmp(pmpkg_t *pkg, pmdepend_t *dep);
+pmlist_t *_pacman_cascadedeps(pmdb_t *db, pmlist_t *targs);
+int _pacman_resolvedeps(pmdb_t *local, pmlist_t *dbs_sync, pmlist_t *list, pmtrans_t *trans, pmlist_t **data);
+int _pacman_depcmp(pmpkg_t *pkg, const pmdepcons_t *dep);
 
 #endif /* _PACMAN_DEPS_H */
 
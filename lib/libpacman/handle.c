@@ -41,6 +41,9 @@
 #include "trans.h"
 #include "pacman.h"
 #include "server.h"
+#include "pool.h"
+#include "path.h"
+#include "bloom.h"
 #include "handle.h"
 
 pmhandle_t *_pacman_handle_new()
@@ -114,9 +117,13 @@ int _pacman_handle_free(pmhandle_t *ph)
 	FREELIST(ph->dbs_sync);
 	FREELIST(ph->noupgrade);
 	FREELIST(ph->noextract);
+	FREE(ph->noupgradebloom);
+	FREE(ph->noextractbloom);
 	FREELIST(ph->ignorepkg);
 	FREELIST(ph->holdpkg);
 	FREELIST(ph->needles);
+	FREEPOOL(ph->strings);
+	_pacman_path_free(ph->paths);
 	free(ph);
 
 	return(0);
@@ -191,6 +198,8 @@ int _pacman_handle_set_option(pmhandle_t *ph, unsigned char val, unsigned long d
 				FREELIST(ph->noupgrade);
 				_pacman_log(PM_LOG_FLOW2, _("PM_OPT_NOUPGRADE flushed"));
 			}
+			FREE(ph->noupgradebloom);
+			ph->noupgradebloom = _pacman_bloom_strs(ph->noupgrade);
 		break;
 		case PM_OPT_NOEXTRACT:
 			if((char *)data && strlen((char *)data) != 0) {
@@ -200,6 +209,8 @@ int _pacman_handle_set_option(pmhandle_t *ph, unsigned char val, unsigned long d
 				FREELIST(ph->noextract);
 				_pacman_log(PM_LOG_FLOW2, _("PM_OPT_NOEXTRACT flushed"));
 			}
+			FREE(ph->noextractbloom);
+			ph->noextractbloom = _pacman_bloom_strs(ph->noextract);
 		break;
 		case PM_OPT_IGNOREPKG:
 			if((char *)data && strlen((char *)data) != 0) {
@@ -54,6 +54,8 @@ struct __pmhandle_t {
 	char *hooksdir;
 	pmlist_t *noupgrade; /* List of strings */
 	pmlist_t *noextract; /* List of strings */
+	struct __pmbloom_t *noupgradebloom; /* filters of the two lists above */
+	struct __pmbloom_t *noextractbloom;
 	pmlist_t *ignorepkg; /* List of strings */
 	pmlist_t *holdpkg; /* List of strings */
 	unsigned char usesyslog;
@@ -71,6 +73,8 @@ struct __pmhandle_t {
 	int *dlremain;
 	int *dlhowmany;
 	int sysupgrade;
+	struct __pmpool_t *strings; /* interned package strings */
+	struct __pmpathstore_t *paths; /* interned file paths */
 };
 
 extern pmhandle_t *handle;
@@ -0,0 +1,167 @@
+/*
+ *  hash.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "util.h"
+#include "hash.h"
+
+#define HASH_MINSIZE 64
+
+/* FNV-1a, on 32 bits whatever the size of a long: the path store keeps the
+ * value in an unsigned int (see path.h) */
+unsigned long _pacman_hash_str(const char *key)
+{
+	unsigned int h = 2166136261U;
+
+	while(*key) {
+		h ^= (unsigned char)*key++;
+		h *= 16777619U;
+	}
+	return(h);
+}
+
+static pmhashnode_t **_pacman_hash_lookup(pmhash_t *hash, const char *key, unsigned long h)
+{
+	pmhashnode_t **node = &hash->buckets[h & (hash->size - 1)];
+
+	while(*node && ((*node)->hash != h || strcmp((*node)->key, key))) {
+		node = &(*node)->next;
+	}
+	return(node);
+}
+
+static int _pacman_hash_grow(pmhash_t *hash)
+{
+	unsigned long i, size = hash->size * 2;
+	pmhashnode_t **buckets = _pacman_zalloc(size * sizeof(pmhashnode_t *));
+
+	if(buckets == NULL) {
+		return(-1);
+	}
+	for(i = 0; i < hash->size; i++) {
+		pmhashnode_t *node, *next;
+		for(node = hash->buckets[i]; node; node = next) {
+			next = node->next;
+			node->next = buckets[node->hash & (size - 1)];
+			buckets[node->hash & (size - 1)] = node;
+		}
+	}
+	free(hash->buckets);
+	hash->buckets = buckets;
+	hash->size = size;
+	return(0);
+}
+
+pmhash_t *_pacman_hash_new(unsigned long hint)
+{
+	pmhash_t *hash = _pacman_zalloc(sizeof(pmhash_t));
+
+	if(hash == NULL) {
+		return(NULL);
+	}
+	for(hash->size = HASH_MINSIZE; hash->size < hint; hash->size *= 2);
+	hash->buckets = _pacman_zalloc(hash->size * sizeof(pmhashnode_t *));
+	if(hash->buckets == NULL) {
+		free(hash);
+		return(NULL);
+	}
+	return(hash);
+}
+
+/* Frees the table, and the indexed data with fn if not NULL */
+void _pacman_hash_free(pmhash_t *hash, _pacman_fn_free fn)
+{
+	unsigned long i;
+
+	if(hash == NULL) {
+		return;
+	}
+	for(i = 0; i < hash->size; i++) {
+		pmhashnode_t *node, *next;
+		for(node = hash->buckets[i]; node; node = next) {
+			next = node->next;
+			if(fn) {
+				fn(node->data);
+			}
+			free(node);
+		}
+	}
+	free(hash->buckets);
+	free(hash);
+}
+
+/* Sets the data stored under key, replacing any previous one */
+int _pacman_hash_add(pmhash_t *hash, const char *key, void *data)
+{
+	unsigned long h = _pacman_hash_str(key);
+	pmhashnode_t **node = _pacman_hash_lookup(hash, key, h);
+
+	if(*node == NULL) {
+		if(hash->count >= hash->size && _pacman_hash_grow(hash) == 0) {
+			node = _pacman_hash_lookup(hash, key, h);
+		}
+		if((*node = _pacman_zalloc(sizeof(pmhashnode_t))) == NULL) {
+			return(-1);
+		}
+		(*node)->hash = h;
+		hash->count++;
+	}
+	(*node)->key = key;
+	(*node)->data = data;
+	return(0);
+}
+
+void *_pacman_hash_get(pmhash_t *hash, const char *key)
+{
+	pmhashnode_t *node;
+
+	if(hash == NULL || key == NULL) {
+		return(NULL);
+	}
+	node = *_pacman_hash_lookup(hash, key, _pacman_hash_str(key));
+	return(node ? node->data : NULL);
+}
+
+/* Removes the entry of key and returns its data, NULL if there was none */
+void *_pacman_hash_remove(pmhash_t *hash, const char *key)
+{
+	pmhashnode_t **node, *found;
+	void *data;
+
+	if(hash == NULL || key == NULL) {
+		return(NULL);
+	}
+	node = _pacman_hash_lookup(hash, key, _pacman_hash_str(key));
+	if((found = *node) == NULL) {
+		return(NULL);
+	}
+	*node = found->next;
+	data = found->data;
+	free(found);
+	hash->count--;
+	return(data);
+}
+
+/* vim: set ts=2 sw=2 noet: */
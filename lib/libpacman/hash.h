@@ -0,0 +1,54 @@
+/*
+ *  hash.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_HASH_H
+#define _PACMAN_HASH_H
+
+#include "list.h"
+
+/* String keyed hash table. Keys are not copied: they must live as long as
+ * their entry, usually by pointing inside the data they index.
+ */
+typedef struct __pmhashnode_t {
+	const char *key;
+	unsigned long hash;
+	void *data;
+	struct __pmhashnode_t *next;
+} pmhashnode_t;
+
+typedef struct __pmhash_t {
+	pmhashnode_t **buckets;
+	unsigned long size; /* a power of 2 */
+	unsigned long count;
+} pmhash_t;
+
+#define _FREEHASH(p, f) do { if(p) { _pacman_hash_free(p, f); p = NULL; } } while(0)
+#define FREEHASH(p) _FREEHASH(p, NULL)
+
+unsigned long _pacman_hash_str(const char *key);
+pmhash_t *_pacman_hash_new(unsigned long hint);
+void _pacman_hash_free(pmhash_t *hash, _pacman_fn_free fn);
+int _pacman_hash_add(pmhash_t *hash, const char *key, void *data);
+void *_pacman_hash_get(pmhash_t *hash, const char *key);
+void *_pacman_hash_remove(pmhash_t *hash, const char *key);
+
+#endif /* _PACMAN_HASH_H */
+
+/* vim: set ts=2 sw=2 noet: */
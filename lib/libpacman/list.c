@@ -133,6 +133,68 @@ pmlist_t *_pacman_list_add_sorted(pmlist_t *list, void *data, _pacman_fn_cmp fn)
 	return(list);
 }
 
+/* Merges two chains sorted by fn, linked through next only */
+static pmlist_t *_pacman_list_merge(pmlist_t *left, pmlist_t *right, _pacman_fn_cmp fn)
+{
+	pmlist_t head, *tail = &head;
+
+	while(left && right) {
+		/* take from the left on ties to keep the sort stable */
+		if(fn(right->data, left->data) < 0) {
+			tail->next = right;
+			right = right->next;
+		} else {
+			tail->next = left;
+			left = left->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = left ? left : right;
+	return(head.next);
+}
+
+static pmlist_t *_pacman_list_msort(pmlist_t *list, int n, _pacman_fn_cmp fn)
+{
+	pmlist_t *right;
+	int i;
+
+	if(n < 2) {
+		if(list) {
+			list->next = NULL;
+		}
+		return(list);
+	}
+	for(right = list, i = 0; i < n / 2; i++) {
+		right = right->next;
+	}
+	right = _pacman_list_msort(right, n - n / 2, fn);
+	list = _pacman_list_msort(list, n / 2, fn);
+	return(_pacman_list_merge(list, right, fn));
+}
+
+/* Sorts a list in place with a stable merge sort and returns its new head.
+ * Building a list with _pacman_list_add() and sorting it once is O(n log n),
+ * where n calls to _pacman_list_add_sorted() are O(n^2).
+ */
+pmlist_t *_pacman_list_sort(pmlist_t *list, _pacman_fn_cmp fn)
+{
+	pmlist_t *lp, *prev = NULL;
+
+	if(list == NULL || list->next == NULL) {
+		return(list);
+	}
+
+	list = _pacman_list_msort(list, _pacman_list_count(list), fn);
+	for(lp = list; lp; lp = lp->next) {
+		lp->prev = prev;
+		lp->last = NULL;
+		prev = lp;
+	}
+	list->last = prev;
+
+	return(list);
+}
+
 /* Remove an item in a list. Use the given comparison function to find the
  * item.
  * If the item is found, 'data' is pointing to the removed element.
@@ -282,4 +344,221 @@ pmlist_t *_pacman_list_strdup(pmlist_t *list)
 	return(newlist);
 }
 
+/* Points the first node at the last one, as in the lists */
+static void _pacman_vector_relast(pmvector_t *vector)
+{
+	if(vector->count > 0) {
+		vector->index[0]->last = vector->index[vector->count - 1];
+	}
+}
+
+static pmvectorchunk_t *_pacman_vector_chunk(int size)
+{
+	pmvectorchunk_t *chunk = _pacman_malloc(sizeof(pmvectorchunk_t) + size * sizeof(pmlist_t));
+
+	if(chunk == NULL) {
+		return(NULL);
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	chunk->size = size;
+	return(chunk);
+}
+
+/* Returns the index of the first element not lower than needle */
+static int _pacman_vector_lowerbound(pmvector_t *vector, const void *needle, _pacman_fn_cmp fn)
+{
+	int lo = 0, hi = vector->count;
+
+	while(lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if(fn(vector->index[mid]->data, needle) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(lo);
+}
+
+/* Links a new node holding data at position pos */
+static int _pacman_vector_insert(pmvector_t *vector, int pos, void *data)
+{
+	pmvectorchunk_t *chunk = vector->chunks;
+	pmlist_t *node;
+
+	if(vector->count == vector->size) {
+		pmlist_t **index = realloc(vector->index, 2 * vector->size * sizeof(pmlist_t *));
+		if(index == NULL) {
+			_pacman_log(PM_LOG_ERROR, _("malloc failure: could not allocate %d bytes"), 2 * vector->size * sizeof(pmlist_t *));
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		vector->index = index;
+		vector->size *= 2;
+	}
+	if(chunk->used == chunk->size) {
+		/* a new block, the nodes given out stay where they are */
+		if((chunk = _pacman_vector_chunk(2 * chunk->size)) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		chunk->next = vector->chunks;
+		vector->chunks = chunk;
+	}
+	node = &chunk->nodes[chunk->used++];
+	node->data = data;
+	node->last = NULL;
+	node->prev = (pos > 0) ? vector->index[pos - 1] : NULL;
+	node->next = (pos < vector->count) ? vector->index[pos] : NULL;
+	if(node->prev) {
+		node->prev->next = node;
+	}
+	if(node->next) {
+		node->next->prev = node;
+		node->next->last = NULL;
+	}
+	memmove(&vector->index[pos + 1], &vector->index[pos], (vector->count - pos) * sizeof(pmlist_t *));
+	vector->index[pos] = node;
+	vector->count++;
+	_pacman_vector_relast(vector);
+	return(0);
+}
+
+pmvector_t *_pacman_vector_new(int size)
+{
+	pmvector_t *vector = _pacman_zalloc(sizeof(pmvector_t));
+
+	if(vector == NULL) {
+		return(NULL);
+	}
+	vector->size = (size > 0) ? size : 16;
+	vector->index = _pacman_malloc(vector->size * sizeof(pmlist_t *));
+	vector->chunks = _pacman_vector_chunk(vector->size);
+	if(vector->index == NULL || vector->chunks == NULL) {
+		free(vector->index);
+		free(vector->chunks);
+		free(vector);
+		return(NULL);
+	}
+	return(vector);
+}
+
+void _pacman_vector_free(pmvector_t *vector, _pacman_fn_free fn)
+{
+	pmvectorchunk_t *chunk;
+	int i;
+
+	if(vector == NULL) {
+		return;
+	}
+	if(fn) {
+		for(i = 0; i < vector->count; i++) {
+			fn(vector->index[i]->data);
+		}
+	}
+	while((chunk = vector->chunks) != NULL) {
+		vector->chunks = chunk->next;
+		free(chunk);
+	}
+	free(vector->index);
+	free(vector);
+}
+
+/* Appends data, the caller is responsible for keeping the vector sorted
+ * (or for calling _pacman_vector_sort() once done).
+ */
+int _pacman_vector_add(pmvector_t *vector, void *data)
+{
+	if(vector == NULL) {
+		return(-1);
+	}
+	return(_pacman_vector_insert(vector, vector->count, data));
+}
+
+/* Inserts data before the first element not lower than it, like
+ * _pacman_list_add_sorted() does.
+ */
+int _pacman_vector_add_sorted(pmvector_t *vector, void *data, _pacman_fn_cmp fn)
+{
+	if(vector == NULL) {
+		return(-1);
+	}
+	return(_pacman_vector_insert(vector, _pacman_vector_lowerbound(vector, data, fn), data));
+}
+
+/* Removes the first element equal to needle according to fn, which must be
+ * the order of the vector. Returns the removed data, or NULL.
+ * The node is unlinked but keeps its own links until the vector is freed, so
+ * that a walk standing on it goes on with the next element.
+ */
+void *_pacman_vector_remove(pmvector_t *vector, const void *needle, _pacman_fn_cmp fn)
+{
+	pmlist_t *node;
+	int i;
+
+	if(vector == NULL) {
+		return(NULL);
+	}
+	i = _pacman_vector_lowerbound(vector, needle, fn);
+	if(i == vector->count || fn(vector->index[i]->data, needle) != 0) {
+		return(NULL);
+	}
+	node = vector->index[i];
+	if(node->prev) {
+		node->prev->next = node->next;
+	}
+	if(node->next) {
+		node->next->prev = node->prev;
+	}
+	node->last = NULL;
+	memmove(&vector->index[i], &vector->index[i + 1], (vector->count - i - 1) * sizeof(pmlist_t *));
+	vector->count--;
+	_pacman_vector_relast(vector);
+	return(node->data);
+}
+
+/* Returns the first element equal to needle according to fn, which must be
+ * the order of the vector.
+ */
+void *_pacman_vector_bsearch(pmvector_t *vector, const void *needle, _pacman_fn_cmp fn)
+{
+	int i;
+
+	if(vector == NULL) {
+		return(NULL);
+	}
+	i = _pacman_vector_lowerbound(vector, needle, fn);
+	if(i == vector->count || fn(vector->index[i]->data, needle) != 0) {
+		return(NULL);
+	}
+	return(vector->index[i]->data);
+}
+
+/* Stable sort, through the list merge sort: the nodes are relinked, not moved */
+void _pacman_vector_sort(pmvector_t *vector, _pacman_fn_cmp fn)
+{
+	pmlist_t *lp;
+	int i;
+
+	if(vector == NULL || vector->count < 2) {
+		return;
+	}
+	for(lp = _pacman_list_sort(vector->index[0], fn), i = 0; lp; lp = lp->next, i++) {
+		vector->index[i] = lp;
+	}
+}
+
+int _pacman_vector_count(pmvector_t *vector)
+{
+	return(vector ? vector->count : 0);
+}
+
+/* The elements of vector, as a list to walk (but never to modify) */
+pmlist_t *_pacman_vector_list(pmvector_t *vector)
+{
+	if(vector == NULL || vector->count == 0) {
+		return(NULL);
+	}
+	return(vector->index[0]);
+}
+
 /* vim: set ts=2 sw=2 noet: */
@@ -29,10 +29,30 @@ typedef struct __pmlist_t {
 	struct __pmlist_t *last; /* Quick access to last item in list */
 } pmlist_t;
 
+/* Sorted collection of list nodes: the nodes are allocated in blocks that
+ * never move and are linked in order, so it can be walked as a list, while
+ * an array of the nodes gives its length and binary searches.
+ */
+typedef struct __pmvectorchunk_t {
+	struct __pmvectorchunk_t *next;
+	int used;
+	int size;
+	pmlist_t nodes[];
+} pmvectorchunk_t;
+
+typedef struct __pmvector_t {
+	pmlist_t **index; /* the linked nodes, in order */
+	int count;
+	int size; /* of index */
+	pmvectorchunk_t *chunks; /* the current chunk first */
+} pmvector_t;
+
 #define _FREELIST(p, f) do { if(p) { _pacman_list_free(p, f); p = NULL; } } while(0)
 #define FREELIST(p) _FREELIST(p, free)
 #define FREELISTPTR(p) _FREELIST(p, NULL)
 
+#define _FREEVECTOR(p, f) do { if(p) { _pacman_vector_free(p, f); p = NULL; } } while(0)
+
 typedef void (*_pacman_fn_free)(void *);
 /* Sort comparison callback function declaration */
 typedef int (*_pacman_fn_cmp)(const void *, const void *);
@@ -41,6 +61,7 @@ pmlist_t *_pacman_list_new(void);
 void _pacman_list_free(pmlist_t *list, _pacman_fn_free fn);
 pmlist_t *_pacman_list_add(pmlist_t *list, void *data);
 pmlist_t *_pacman_list_add_sorted(pmlist_t *list, void *data, _pacman_fn_cmp fn);
+pmlist_t *_pacman_list_sort(pmlist_t *list, _pacman_fn_cmp fn);
 pmlist_t *_pacman_list_remove(pmlist_t *haystack, void *needle, _pacman_fn_cmp fn, void **data);
 int _pacman_list_count(pmlist_t *list);
 int _pacman_list_is_in(void *needle, pmlist_t *haystack);
@@ -50,6 +71,16 @@ pmlist_t *_pacman_list_remove_dupes(pmlist_t *list);
 pmlist_t *_pacman_list_reverse(pmlist_t *list);
 pmlist_t *_pacman_list_strdup(pmlist_t *list);
 
+pmvector_t *_pacman_vector_new(int size);
+void _pacman_vector_free(pmvector_t *vector, _pacman_fn_free fn);
+int _pacman_vector_add(pmvector_t *vector, void *data);
+int _pacman_vector_add_sorted(pmvector_t *vector, void *data, _pacman_fn_cmp fn);
+void *_pacman_vector_remove(pmvector_t *vector, const void *needle, _pacman_fn_cmp fn);
+void *_pacman_vector_bsearch(pmvector_t *vector, const void *needle, _pacman_fn_cmp fn);
+void _pacman_vector_sort(pmvector_t *vector, _pacman_fn_cmp fn);
+int _pacman_vector_count(pmvector_t *vector);
+pmlist_t *_pacman_vector_list(pmvector_t *vector);
+
 #endif /* _PACMAN_LIST_H */
 
 /* vim: set ts=2 sw=2 noet: */
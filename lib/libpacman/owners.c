@@ -0,0 +1,1050 @@
+/*
+ *  owners.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "list.h"
+#include "hash.h"
+#include "pool.h"
+#include "package.h"
+#include "db.h"
+#include "cache.h"
+#include "handle.h"
+#include "error.h"
+#include "owners.h"
+
+/* The owners index of the local database maps the installed files to their
+ * packages, so that looking for the owners of some files costs a binary
+ * search per file instead of reading the file list of every installed
+ * package.
+ *
+ * Layout (host byte order, like the snapshot):
+ *   header
+ *   package table  for each package, sorted by name, the offset of its
+ *                  "name version" and the stamp of its files entry
+ *   path table     a (path offset, package number) pair for each file of
+ *                  each package, sorted by path
+ *   strings        NUL terminated, each path stored once
+ *   journal        the changes made since the tables were written:
+ *     "+stamp name version"  the file list of a package, replacing any
+ *                            previous one
+ *     " path"                a file of the last package
+ *     "-name version"        the package was removed
+ * _pacman_db_write() and _pacman_db_remove() append to the journal, and the
+ * packages it names hide their entries of the tables.  A query reads the
+ * journal, then binary searches the path table for each path.  Once the
+ * journal grows past OWNERS_JOURNAL_RECS records or OWNERS_JOURNAL_SIZE
+ * bytes, the query merges it into new tables.  Queries build and merge the
+ * index only with a read-write access and the database lock, so that they do
+ * not race a transaction appending to the journal.
+ *
+ * The header holds the stat of the db directory after the last change made
+ * through libpacman, like the snapshot key does, and each package the stamp
+ * of its files entry (see _pacman_db_stamp()): if an entry was added,
+ * removed or had its file list edited behind our back, the index is out of
+ * date and gets rebuilt.
+ */
+
+#define OWNERS_MAGIC   "PMOWNS"
+#define OWNERS_VERSION 3
+
+/* merge the journal into the tables past this many records or bytes */
+#define OWNERS_JOURNAL_RECS 32
+#define OWNERS_JOURNAL_SIZE (256 * 1024)
+
+/* hex digits of the stamp of a "+" record */
+#define OWNERS_STAMP_LEN 16
+
+typedef struct __pmownerskey_t {
+	unsigned long long dev;
+	unsigned long long ino;
+	unsigned long long size;
+	unsigned long long mtime;
+	unsigned long long mtimensec; /* 0 if the file system has no better than seconds */
+} pmownerskey_t;
+
+typedef struct __pmownershdr_t {
+	char magic[8];
+	unsigned int version;
+	unsigned int npkgs; /* entries of the package table */
+	unsigned int nrecs; /* entries of the path table */
+	unsigned int journal; /* offset of the journal, the end of the tables */
+	pmownerskey_t key;
+} pmownershdr_t;
+
+/* An entry of the package table */
+typedef struct __pmownerspkg_t {
+	unsigned long long stamp; /* of the files entry of the package */
+	unsigned int str; /* offset of its "name version" */
+	unsigned int unused;
+} pmownerspkg_t;
+
+/* An entry of the path table */
+typedef struct __pmownersrec_t {
+	unsigned int path; /* offset of the path */
+	unsigned int pkg; /* index in the package table */
+} pmownersrec_t;
+
+/* A mapped index, with its journal read */
+typedef struct __pmowners_t {
+	char *base;
+	size_t size;
+	const pmownershdr_t *hdr;
+	const pmownerspkg_t *pkgs;
+	const pmownersrec_t *recs;
+	unsigned int strings; /* offset of the strings */
+	char *journal; /* a copy of the journal, split in lines */
+	char *journalend;
+	unsigned int journalrecs; /* "+" and "-" records of the journal */
+	pmhash_t *entries; /* name -> pmownersentry_t, for the packages of the journal */
+	pmpool_t *pool; /* the copy of the journal and the entries */
+} pmowners_t;
+
+/* A package of the journal */
+typedef struct __pmownersentry_t {
+	const char *key; /* "name version" of its live record */
+	unsigned long long stamp; /* of its live record */
+	pmpkg_t *pkg; /* the package of the live record, if in the cache */
+	unsigned int last; /* its live record, 0 once removed */
+	unsigned int index; /* in the package table, when merging */
+} pmownersentry_t;
+
+/* A package to be written in the package table */
+typedef struct __pmownersnew_t {
+	const char *key; /* "name version" */
+	unsigned long long stamp;
+} pmownersnew_t;
+
+/* A file of a package, to be written in the path table */
+typedef struct __pmownerspair_t {
+	const char *path;
+	unsigned int pkg; /* index in the packages to be written */
+} pmownerspair_t;
+
+static int _pacman_db_owners_key(pmdb_t *db, pmownerskey_t *key)
+{
+	struct stat buf;
+
+	memset(key, 0, sizeof(pmownerskey_t));
+	/* adding or removing an entry updates the mtime of the db directory */
+	if(stat(db->path, &buf) != 0) {
+		return(-1);
+	}
+	key->dev = buf.st_dev;
+	key->ino = buf.st_ino;
+	key->size = buf.st_size;
+	key->mtime = buf.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	/* an entry added and another removed within the same second */
+	key->mtimensec = buf.st_mtim.tv_nsec;
+#endif
+	return(0);
+}
+
+/* Whether hdr is the one of an index, up to date if uptodate is set */
+static int _pacman_db_owners_valid(pmdb_t *db, const pmownershdr_t *hdr, int uptodate)
+{
+	pmownerskey_t key;
+
+	if(strcmp(hdr->magic, OWNERS_MAGIC) || hdr->version != OWNERS_VERSION ||
+		(uptodate && (_pacman_db_owners_key(db, &key) == -1 || memcmp(&hdr->key, &key, sizeof(key))))) {
+		_pacman_log(PM_LOG_DEBUG, _("owners index for '%s' is out of date"), db->treename);
+		return(0);
+	}
+	return(1);
+}
+
+/* Drops the index of db, it will be rebuilt by the next query */
+void _pacman_db_owners_invalidate(pmdb_t *db)
+{
+	char path[PATH_MAX];
+
+	if(db == NULL) {
+		return;
+	}
+	snprintf(path, PATH_MAX, "%s" OWNERS_EXT, db->path);
+	unlink(path);
+}
+
+/* To be called before changing the local database: the index is dropped if
+ * it is already out of date, so that our update does not hide it.
+ */
+void _pacman_db_owners_check(pmdb_t *db)
+{
+	char path[PATH_MAX];
+	pmownershdr_t hdr;
+	FILE *fp;
+
+	if(db == NULL || db != handle->db_local) {
+		return;
+	}
+	snprintf(path, PATH_MAX, "%s" OWNERS_EXT, db->path);
+	if((fp = fopen(path, "r")) == NULL) {
+		return;
+	}
+	if(fread(&hdr, sizeof(hdr), 1, fp) != 1 || !_pacman_db_owners_valid(db, &hdr, 1)) {
+		_pacman_db_owners_invalidate(db);
+	}
+	fclose(fp);
+}
+
+/* Records a change of the local database made after _pacman_db_owners_check() */
+void _pacman_db_owners_update(pmdb_t *db, pmpkg_t *info, int op)
+{
+	char path[PATH_MAX];
+	pmownershdr_t hdr;
+	pmlist_t *lp;
+	FILE *fp;
+	int ret = -1;
+
+	if(db == NULL || db != handle->db_local) {
+		return;
+	}
+	snprintf(path, PATH_MAX, "%s" OWNERS_EXT, db->path);
+	if((fp = fopen(path, "r+")) == NULL) {
+		/* no index yet */
+		return;
+	}
+	if(fread(&hdr, sizeof(hdr), 1, fp) == 1 && _pacman_db_owners_valid(db, &hdr, 0) &&
+		fseek(fp, 0, SEEK_END) == 0) {
+		if(op == PM_OWNERS_ADD) {
+			fprintf(fp, "+%0*llx %s %s\n", OWNERS_STAMP_LEN,
+				_pacman_db_stamp(db, info->name, info->version, INFRQ_FILES), info->name, info->version);
+			for(lp = info->files; lp; lp = lp->next) {
+				fprintf(fp, " %s\n", (char *)lp->data);
+			}
+		} else if(op == PM_OWNERS_REMOVE) {
+			fprintf(fp, "-%s %s\n", info->name, info->version);
+		}
+		if(_pacman_db_owners_key(db, &hdr.key) == 0 && fseek(fp, 0, SEEK_SET) == 0) {
+			fwrite(&hdr, sizeof(hdr), 1, fp);
+			ret = 0;
+		}
+	}
+	if(ferror(fp) | fclose(fp) || ret == -1) {
+		_pacman_log(PM_LOG_WARNING, _("could not update the owners index of '%s'"), db->treename);
+		_pacman_db_owners_invalidate(db);
+	}
+}
+
+static int _pacman_db_owners_newcmp(const void *p1, const void *p2)
+{
+	const pmownersnew_t *new1 = *(pmownersnew_t * const *)p1, *new2 = *(pmownersnew_t * const *)p2;
+
+	/* the space sorts before the characters of the names: this is the order
+	 * of the names */
+	return(strcmp(new1->key, new2->key));
+}
+
+static int _pacman_db_owners_paircmp(const void *p1, const void *p2)
+{
+	const pmownerspair_t *pair1 = p1, *pair2 = p2;
+	int ret = strcmp(pair1->path, pair2->path);
+
+	if(ret == 0) {
+		ret = (pair1->pkg > pair2->pkg) - (pair1->pkg < pair2->pkg);
+	}
+	return(ret);
+}
+
+/* Writes the tables of an index of db with an empty journal: pkgs are the
+ * packages, pairs their files.  pairs gets sorted.
+ */
+static int _pacman_db_owners_write(pmdb_t *db, const pmownerskey_t *key,
+	pmownersnew_t *pkgs, unsigned int npkgs, pmownerspair_t *pairs, unsigned int npairs)
+{
+	char path[PATH_MAX], tmppath[PATH_MAX + sizeof(".XXXXXX")];
+	pmownershdr_t hdr;
+	pmownerspkg_t pkg;
+	pmownersrec_t rec;
+	pmownersnew_t **sorted;
+	unsigned int *place;
+	unsigned long long offset, end;
+	unsigned int i;
+	FILE *fp;
+	int fd;
+
+	/* sort the packages by name, and their files by path */
+	sorted = _pacman_malloc((npkgs + 1) * sizeof(pmownersnew_t *));
+	place = _pacman_malloc((npkgs + 1) * sizeof(unsigned int));
+	if(sorted == NULL || place == NULL) {
+		FREE(sorted);
+		FREE(place);
+		return(-1);
+	}
+	for(i = 0; i < npkgs; i++) {
+		sorted[i] = &pkgs[i];
+	}
+	qsort(sorted, npkgs, sizeof(pmownersnew_t *), _pacman_db_owners_newcmp);
+	for(i = 0; i < npkgs; i++) {
+		place[sorted[i] - pkgs] = i;
+	}
+	for(i = 0; i < npairs; i++) {
+		pairs[i].pkg = place[pairs[i].pkg];
+	}
+	FREE(place);
+	qsort(pairs, npairs, sizeof(pmownerspair_t), _pacman_db_owners_paircmp);
+
+	/* the strings follow the tables, each path once */
+	offset = sizeof(hdr) + (unsigned long long)npkgs * sizeof(pmownerspkg_t) +
+		(unsigned long long)npairs * sizeof(pmownersrec_t);
+	end = offset;
+	for(i = 0; i < npkgs; i++) {
+		end += strlen(pkgs[i].key) + 1;
+	}
+	for(i = 0; i < npairs; i++) {
+		if(i == 0 || strcmp(pairs[i].path, pairs[i-1].path)) {
+			end += strlen(pairs[i].path) + 1;
+		}
+	}
+	if(end > UINT_MAX) {
+		FREE(sorted);
+		return(-1);
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	strcpy(hdr.magic, OWNERS_MAGIC);
+	hdr.version = OWNERS_VERSION;
+	hdr.npkgs = npkgs;
+	hdr.nrecs = npairs;
+	hdr.journal = end;
+	hdr.key = *key;
+
+	snprintf(path, PATH_MAX, "%s" OWNERS_EXT, db->path);
+	snprintf(tmppath, sizeof(tmppath), "%s.XXXXXX", path);
+	if((fd = mkstemp(tmppath)) == -1) {
+		/* most likely a read-only access to the database */
+		FREE(sorted);
+		return(-1);
+	}
+	if((fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlink(tmppath);
+		FREE(sorted);
+		return(-1);
+	}
+	fchmod(fd, 0644);
+
+	_pacman_log(PM_LOG_DEBUG, _("writing owners index for '%s'"), db->treename);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	end = offset;
+	memset(&pkg, 0, sizeof(pkg));
+	for(i = 0; i < npkgs; i++) {
+		pkg.stamp = sorted[i]->stamp;
+		pkg.str = end;
+		fwrite(&pkg, sizeof(pkg), 1, fp);
+		end += strlen(sorted[i]->key) + 1;
+	}
+	for(i = 0; i < npairs; i++) {
+		if(i == 0 || strcmp(pairs[i].path, pairs[i-1].path)) {
+			rec.path = end;
+			end += strlen(pairs[i].path) + 1;
+		}
+		rec.pkg = pairs[i].pkg;
+		fwrite(&rec, sizeof(rec), 1, fp);
+	}
+	for(i = 0; i < npkgs; i++) {
+		fwrite(sorted[i]->key, strlen(sorted[i]->key) + 1, 1, fp);
+	}
+	for(i = 0; i < npairs; i++) {
+		if(i == 0 || strcmp(pairs[i].path, pairs[i-1].path)) {
+			fwrite(pairs[i].path, strlen(pairs[i].path) + 1, 1, fp);
+		}
+	}
+	FREE(sorted);
+	if(ferror(fp) | fclose(fp)) {
+		_pacman_log(PM_LOG_WARNING, _("could not write owners index %s"), path);
+		unlink(tmppath);
+		return(-1);
+	}
+	if(rename(tmppath, path) != 0) {
+		unlink(tmppath);
+		return(-1);
+	}
+	return(0);
+}
+
+/* Writes the index of db from the file lists of its package cache, reading
+ * them from the database on the way.
+ */
+static int _pacman_db_owners_build(pmdb_t *db)
+{
+	pmownerskey_t key;
+	pmownerspair_t *pairs = NULL;
+	pmownersnew_t *pkgs = NULL;
+	unsigned int npkgs = 0, npairs = 0;
+	pmpool_t *pool = NULL;
+	pmlist_t *lp, *i;
+	int ret = -1;
+
+	/* stat the database first, so that changes made while we are reading it
+	 * make the index out of date */
+	if(_pacman_db_owners_key(db, &key) == -1) {
+		return(-1);
+	}
+	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+		npkgs++;
+	}
+	if((pkgs = _pacman_malloc((npkgs + 1) * sizeof(pmownersnew_t))) == NULL) {
+		return(-1);
+	}
+	npkgs = 0;
+	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+		pmpkg_t *info = lp->data;
+
+		/* the stamps as well before reading the file lists */
+		pkgs[npkgs++].stamp = _pacman_db_stamp(db, info->name, info->version, INFRQ_FILES);
+		npairs += _pacman_list_count(_pacman_pkg_getinfo(info, PM_PKG_FILES));
+	}
+
+	if((pool = _pacman_pool_new(0)) == NULL ||
+		(pairs = _pacman_malloc((npairs + 1) * sizeof(pmownerspair_t))) == NULL) {
+		goto cleanup;
+	}
+	npkgs = npairs = 0;
+	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+		pmpkg_t *info = lp->data;
+		char *str = _pacman_pool_alloc(pool, strlen(info->name) + strlen(info->version) + 2);
+
+		if(str == NULL) {
+			goto cleanup;
+		}
+		sprintf(str, "%s %s", info->name, info->version);
+		for(i = info->files; i; i = i->next) {
+			pairs[npairs].path = i->data;
+			pairs[npairs++].pkg = npkgs;
+		}
+		pkgs[npkgs++].key = str;
+	}
+	ret = _pacman_db_owners_write(db, &key, pkgs, npkgs, pairs, npairs);
+
+cleanup:
+	FREE(pkgs);
+	FREE(pairs);
+	FREEPOOL(pool);
+	return(ret);
+}
+
+/* Takes the database lock to rewrite the index, unless the handle already
+ * holds it for a transaction.
+ * Returns 1 if the lock was taken here, 0 if it was already held, or -1 if
+ * the index must be used as it is.
+ */
+static int _pacman_db_owners_lock(void)
+{
+	char path[PATH_MAX];
+	int fd;
+
+	if(handle->access != PM_ACCESS_RW) {
+		return(-1);
+	}
+	if(handle->lckfd != -1) {
+		return(0);
+	}
+	snprintf(path, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
+	if((fd = _pacman_lckmk(path)) == -1) {
+		/* a transaction is on-going, it is appending to the journal */
+		return(-1);
+	}
+	handle->lckfd = fd;
+	return(1);
+}
+
+static void _pacman_db_owners_unlock(int locked)
+{
+	char path[PATH_MAX];
+
+	if(locked != 1) {
+		return;
+	}
+	close(handle->lckfd);
+	handle->lckfd = -1;
+	snprintf(path, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
+	if(_pacman_lckrm(path)) {
+		_pacman_log(PM_LOG_WARNING, _("could not remove lock file %s"), path);
+	}
+}
+
+static void _pacman_db_owners_unmap(pmowners_t *map)
+{
+	munmap(map->base, map->size);
+	FREEHASH(map->entries);
+	FREEPOOL(map->pool);
+	free(map);
+}
+
+/* Maps the index of db if its key is up to date */
+static pmowners_t *_pacman_db_owners_map(pmdb_t *db)
+{
+	char path[PATH_MAX];
+	struct stat buf;
+	pmowners_t *map;
+	const pmownershdr_t *hdr;
+	unsigned long long strings;
+	void *base;
+	int fd;
+
+	snprintf(path, PATH_MAX, "%s" OWNERS_EXT, db->path);
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(NULL);
+	}
+	if(fstat(fd, &buf) != 0 || (size_t)buf.st_size < sizeof(pmownershdr_t)) {
+		close(fd);
+		return(NULL);
+	}
+	base = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) {
+		return(NULL);
+	}
+
+	hdr = base;
+	strings = sizeof(pmownershdr_t) + (unsigned long long)hdr->npkgs * sizeof(pmownerspkg_t) +
+		(unsigned long long)hdr->nrecs * sizeof(pmownersrec_t);
+	if(!_pacman_db_owners_valid(db, hdr, 1) ||
+		strings > hdr->journal || hdr->journal > (unsigned long long)buf.st_size ||
+		(strings < hdr->journal && ((char *)base)[hdr->journal - 1] != '\0') ||
+		(map = _pacman_zalloc(sizeof(pmowners_t))) == NULL) {
+		munmap(base, buf.st_size);
+		return(NULL);
+	}
+	map->base = base;
+	map->size = buf.st_size;
+	map->hdr = hdr;
+	map->pkgs = (const pmownerspkg_t *)(map->base + sizeof(pmownershdr_t));
+	map->recs = (const pmownersrec_t *)(map->pkgs + hdr->npkgs);
+	map->strings = strings;
+	return(map);
+}
+
+/* Returns the string at offset, NULL if it is not in the strings */
+static const char *_pacman_db_owners_str(pmowners_t *map, unsigned int offset)
+{
+	if(offset < map->strings || offset >= map->hdr->journal) {
+		return(NULL);
+	}
+	return(map->base + offset);
+}
+
+/* Returns the index in the package table of the package called name, or -1 */
+static int _pacman_db_owners_table(pmowners_t *map, const char *name)
+{
+	char prefix[PKG_NAME_LEN + 1];
+	unsigned int lo = 0, hi = map->hdr->npkgs;
+	size_t len = strlen(name);
+
+	if(len >= PKG_NAME_LEN) {
+		return(-1);
+	}
+	/* the strings of the package are the ones starting with "name " */
+	memcpy(prefix, name, len);
+	prefix[len++] = ' ';
+	while(lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const char *str = _pacman_db_owners_str(map, map->pkgs[mid].str);
+		int cmp;
+
+		if(str == NULL) {
+			return(-1);
+		}
+		if((cmp = strncmp(str, prefix, len)) == 0) {
+			return(mid);
+		} else if(cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(-1);
+}
+
+/* Splits a "+" or "-" line of the journal, returning its "name version", with
+ * the stamp of a "+" line in stamp. Returns NULL if the line is corrupted.
+ */
+static char *_pacman_db_owners_record(char *line, unsigned long long *stamp)
+{
+	char *end;
+
+	if(line[0] == '-') {
+		return(line + 1);
+	}
+	*stamp = strtoull(line + 1, &end, 16);
+	if(end != line + 1 + OWNERS_STAMP_LEN || *end != ' ') {
+		return(NULL);
+	}
+	return(end + 1);
+}
+
+/* Reads the journal of map into a copy split in lines, and indexes the
+ * packages it changed by name in map->entries.
+ * Returns -1 if the journal is corrupted.
+ */
+static int _pacman_db_owners_journal(pmowners_t *map)
+{
+	size_t len = map->size - map->hdr->journal;
+	pmownersentry_t *entry;
+	unsigned long long stamp = 0;
+	char *line, *end, *key, *version;
+
+	map->pool = _pacman_pool_new(0);
+	map->entries = _pacman_hash_new(0);
+	if(map->pool == NULL || map->entries == NULL ||
+		(map->journal = _pacman_pool_alloc(map->pool, len + 1)) == NULL) {
+		return(-1);
+	}
+	memcpy(map->journal, map->base + map->hdr->journal, len);
+	map->journalend = map->journal + len;
+
+	for(line = map->journal; line < map->journalend; line = end + 1) {
+		if((end = memchr(line, '\n', map->journalend - line)) == NULL) {
+			/* truncated */
+			return(-1);
+		}
+		*end = '\0';
+		if(line[0] == ' ') {
+			continue;
+		}
+		if((line[0] != '+' && line[0] != '-') ||
+			(key = _pacman_db_owners_record(line, &stamp)) == NULL ||
+			(version = strchr(key, ' ')) == NULL) {
+			return(-1);
+		}
+		map->journalrecs++;
+		*version = '\0';
+		if((entry = _pacman_hash_get(map->entries, key)) == NULL) {
+			char *name = _pacman_pool_strdup(map->pool, key);
+			if(name == NULL || (entry = _pacman_pool_alloc(map->pool, sizeof(pmownersentry_t))) == NULL) {
+				return(-1);
+			}
+			memset(entry, 0, sizeof(pmownersentry_t));
+			_pacman_hash_add(map->entries, name, entry);
+		}
+		*version = ' ';
+		if(line[0] == '+') {
+			entry->key = key;
+			entry->stamp = stamp;
+			entry->last = map->journalrecs;
+		} else {
+			entry->last = 0;
+		}
+	}
+	return(0);
+}
+
+/* Checks the packages of the index against the package cache of db and the
+ * stamps of their files entries.
+ * Returns -1 if the index is out of date.
+ */
+static int _pacman_db_owners_verify(pmdb_t *db, pmowners_t *map)
+{
+	unsigned int live = map->hdr->npkgs, count = 0;
+	pmhashnode_t *node;
+	pmlist_t *lp;
+	unsigned long i;
+
+	/* the packages the index knows */
+	for(i = 0; i < map->entries->size; i++) {
+		for(node = map->entries->buckets[i]; node; node = node->next) {
+			pmownersentry_t *entry = node->data;
+			if(_pacman_db_owners_table(map, node->key) != -1) {
+				live--;
+			}
+			if(entry->last) {
+				live++;
+			}
+		}
+	}
+
+	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next, count++) {
+		pmpkg_t *info = lp->data;
+		pmownersentry_t *entry = _pacman_hash_get(map->entries, info->name);
+		unsigned long long stamp;
+		const char *key;
+		int n;
+
+		if(entry != NULL) {
+			if(!entry->last) {
+				break;
+			}
+			key = entry->key;
+			stamp = entry->stamp;
+		} else if((n = _pacman_db_owners_table(map, info->name)) != -1) {
+			key = _pacman_db_owners_str(map, map->pkgs[n].str);
+			stamp = map->pkgs[n].stamp;
+		} else {
+			break;
+		}
+		if(strcmp(strchr(key, ' ') + 1, info->version) ||
+			_pacman_db_stamp(db, info->name, info->version, INFRQ_FILES) != stamp) {
+			break;
+		}
+	}
+	if(lp != NULL || count != live) {
+		_pacman_log(PM_LOG_DEBUG, _("owners index for '%s' is out of date"), db->treename);
+		return(-1);
+	}
+	return(0);
+}
+
+/* Returns the up to date index of db, building it first if writable is set.
+ * Returns NULL if there is none to use.
+ */
+static pmowners_t *_pacman_db_owners_load(pmdb_t *db, int writable)
+{
+	pmowners_t *map;
+	int built = 0;
+
+	while(1) {
+		if((map = _pacman_db_owners_map(db)) != NULL) {
+			if(_pacman_db_owners_journal(map) == 0 && _pacman_db_owners_verify(db, map) == 0) {
+				return(map);
+			}
+			_pacman_db_owners_unmap(map);
+			if(writable) {
+				_pacman_db_owners_invalidate(db);
+			}
+		}
+		if(!writable || built || _pacman_db_owners_build(db) == -1) {
+			return(NULL);
+		}
+		built = 1;
+	}
+}
+
+/* Returns the package of db of a "name version" string of the index, NULL
+ * if it is not in the cache, or if the journal names it.
+ */
+static pmpkg_t *_pacman_db_owners_pkg(pmdb_t *db, pmowners_t *map, const char *str)
+{
+	char name[PKG_NAME_LEN];
+	const char *version = strchr(str, ' ');
+	pmpkg_t *pkg;
+
+	if(version == NULL || version - str >= PKG_NAME_LEN) {
+		return(NULL);
+	}
+	memcpy(name, str, version - str);
+	name[version - str] = '\0';
+	if(_pacman_hash_get(map->entries, name) != NULL ||
+		(pkg = _pacman_db_get_pkgfromcache(db, name)) == NULL || strcmp(pkg->version, version + 1)) {
+		return(NULL);
+	}
+	return(pkg);
+}
+
+/* Adds the packages of the path table having path to *owners.
+ * Returns -1 if the table is corrupted.
+ */
+static int _pacman_db_owners_search(pmdb_t *db, pmowners_t *map, const char *path, pmlist_t **owners)
+{
+	unsigned int lo = 0, hi = map->hdr->nrecs;
+	const char *str;
+	pmpkg_t *pkg;
+
+	/* the first entry of path */
+	while(lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if((str = _pacman_db_owners_str(map, map->recs[mid].path)) == NULL) {
+			return(-1);
+		}
+		if(strcmp(str, path) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for(; lo < map->hdr->nrecs; lo++) {
+		const pmownersrec_t *rec = &map->recs[lo];
+		if((str = _pacman_db_owners_str(map, rec->path)) == NULL) {
+			return(-1);
+		}
+		if(strcmp(str, path)) {
+			break;
+		}
+		if(rec->pkg >= map->hdr->npkgs || (str = _pacman_db_owners_str(map, map->pkgs[rec->pkg].str)) == NULL) {
+			return(-1);
+		}
+		if((pkg = _pacman_db_owners_pkg(db, map, str)) != NULL) {
+			*owners = _pacman_list_add(*owners, pkg);
+		}
+	}
+	return(0);
+}
+
+/* Writes new tables from the ones of map and its journal */
+static int _pacman_db_owners_compact(pmdb_t *db, pmowners_t *map)
+{
+	pmownerspair_t *pairs = NULL;
+	pmownersnew_t *pkgs = NULL;
+	unsigned int *index = NULL;
+	unsigned int npkgs = 0, npairs = 0, rec = 0, i;
+	unsigned long long stamp = 0;
+	pmownersentry_t *entry = NULL;
+	pmhashnode_t *node;
+	char *line;
+	int ret = -1;
+
+	/* room for the tables plus every record of the journal */
+	for(line = map->journal; line < map->journalend; line += strlen(line) + 1) {
+		npairs++;
+	}
+	if((pkgs = _pacman_malloc((map->hdr->npkgs + map->entries->count + 1) * sizeof(pmownersnew_t))) == NULL ||
+		(index = _pacman_malloc((map->hdr->npkgs + 1) * sizeof(unsigned int))) == NULL ||
+		(pairs = _pacman_malloc((map->hdr->nrecs + npairs + 1) * sizeof(pmownerspair_t))) == NULL) {
+		goto cleanup;
+	}
+	npairs = 0;
+
+	_pacman_log(PM_LOG_DEBUG, _("compacting owners index for '%s'"), db->treename);
+	/* the packages of the tables the journal does not name */
+	for(i = 0; i < map->hdr->npkgs; i++) {
+		const char *str = _pacman_db_owners_str(map, map->pkgs[i].str), *version;
+		char name[PKG_NAME_LEN];
+
+		if(str == NULL || (version = strchr(str, ' ')) == NULL || version - str >= PKG_NAME_LEN) {
+			goto cleanup;
+		}
+		memcpy(name, str, version - str);
+		name[version - str] = '\0';
+		index[i] = UINT_MAX;
+		if(_pacman_hash_get(map->entries, name) == NULL) {
+			index[i] = npkgs;
+			pkgs[npkgs].key = str;
+			pkgs[npkgs++].stamp = map->pkgs[i].stamp;
+		}
+	}
+	for(i = 0; i < map->hdr->nrecs; i++) {
+		const pmownersrec_t *r = &map->recs[i];
+		if(r->pkg >= map->hdr->npkgs || (pairs[npairs].path = _pacman_db_owners_str(map, r->path)) == NULL) {
+			goto cleanup;
+		}
+		if(index[r->pkg] != UINT_MAX) {
+			pairs[npairs++].pkg = index[r->pkg];
+		}
+	}
+	/* then the live records of the journal */
+	for(i = 0; i < map->entries->size; i++) {
+		for(node = map->entries->buckets[i]; node; node = node->next) {
+			entry = node->data;
+			if(entry->last) {
+				entry->index = npkgs;
+				pkgs[npkgs].key = entry->key;
+				pkgs[npkgs++].stamp = entry->stamp;
+			}
+		}
+	}
+	entry = NULL;
+	for(line = map->journal; line < map->journalend; line += strlen(line) + 1) {
+		if(line[0] == '+' || line[0] == '-') {
+			char *key = _pacman_db_owners_record(line, &stamp), *version = strchr(key, ' ');
+			rec++;
+			*version = '\0';
+			entry = _pacman_hash_get(map->entries, key);
+			*version = ' ';
+			if(line[0] == '-' || entry->last != rec) {
+				entry = NULL;
+			}
+		} else if(entry != NULL) {
+			pairs[npairs].path = line + 1;
+			pairs[npairs++].pkg = entry->index;
+		}
+	}
+	/* the database did not change, the key is still valid */
+	ret = _pacman_db_owners_write(db, &map->hdr->key, pkgs, npkgs, pairs, npairs);
+
+cleanup:
+	FREE(pkgs);
+	FREE(index);
+	FREE(pairs);
+	return(ret);
+}
+
+/* Looks for the queried paths of slots in the index mapped by map.
+ * Returns -1 if the index is corrupted.
+ */
+static int _pacman_db_owners_lookup(pmdb_t *db, pmowners_t *map, const char **paths, int count,
+	const int *alias, pmhash_t *slots, pmlist_t **owners)
+{
+	pmownersentry_t *entry = NULL;
+	unsigned long long stamp = 0;
+	pmhashnode_t *node;
+	unsigned int rec = 0;
+	unsigned long i;
+	char *line;
+	int n;
+
+	/* the packages of the live records of the journal */
+	for(i = 0; i < map->entries->size; i++) {
+		for(node = map->entries->buckets[i]; node; node = node->next) {
+			entry = node->data;
+			if(entry->last) {
+				entry->pkg = _pacman_db_get_pkgfromcache(db, node->key);
+				if(entry->pkg && strcmp(entry->pkg->version, strchr(entry->key, ' ') + 1)) {
+					entry->pkg = NULL;
+				}
+			}
+		}
+	}
+
+	for(n = 0; n < count; n++) {
+		if(paths[n] != NULL && alias[n] == n &&
+			_pacman_db_owners_search(db, map, paths[n], &owners[n]) == -1) {
+			return(-1);
+		}
+	}
+	/* then the files of the live records of the journal */
+	entry = NULL;
+	for(line = map->journal; line < map->journalend; line += strlen(line) + 1) {
+		if(line[0] == '+' || line[0] == '-') {
+			char *key = _pacman_db_owners_record(line, &stamp), *version = strchr(key, ' ');
+			rec++;
+			*version = '\0';
+			entry = _pacman_hash_get(map->entries, key);
+			*version = ' ';
+			if(line[0] == '-' || entry->last != rec || entry->pkg == NULL) {
+				entry = NULL;
+			}
+		} else if(entry != NULL) {
+			void *slot = _pacman_hash_get(slots, line + 1);
+			if(slot != NULL) {
+				owners[(long)slot - 1] = _pacman_list_add(owners[(long)slot - 1], entry->pkg);
+			}
+		}
+	}
+	return(0);
+}
+
+/* Looks for the queried paths in the file lists of the package cache */
+static void _pacman_db_owners_scancache(pmdb_t *db, pmhash_t *slots, pmlist_t **owners)
+{
+	pmlist_t *lp, *i;
+
+	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+		pmpkg_t *info = lp->data;
+		for(i = _pacman_pkg_getinfo(info, PM_PKG_FILES); i; i = i->next) {
+			void *slot = _pacman_hash_get(slots, i->data);
+			if(slot != NULL) {
+				owners[(long)slot - 1] = _pacman_list_add(owners[(long)slot - 1], info);
+			}
+		}
+	}
+}
+
+/* Finds the owners of count paths at once. The paths are relative to the
+ * root, with a trailing slash for the directories, like in the file lists.
+ * owners[i] is set to the list of the packages of db having paths[i], or to
+ * NULL if none has it or if paths[i] is NULL.
+ * Returns the number of owned paths, or -1 on error.
+ */
+int _pacman_db_owners_find(pmdb_t *db, const char **paths, int count, pmlist_t **owners)
+{
+	pmhash_t *slots;
+	pmlist_t *lp;
+	pmowners_t *map;
+	int *alias;
+	int i, locked, found = 0;
+
+	if(db == NULL || paths == NULL || owners == NULL) {
+		RET_ERR(PM_ERR_WRONG_ARGS, -1);
+	}
+	memset(owners, 0, count * sizeof(pmlist_t *));
+	if(count <= 0) {
+		return(0);
+	}
+
+	/* index the queries, a path asked twice shares the answer of the first */
+	slots = _pacman_hash_new(count);
+	alias = _pacman_malloc(count * sizeof(int));
+	if(slots == NULL || alias == NULL) {
+		FREEHASH(slots);
+		FREE(alias);
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+	for(i = 0; i < count; i++) {
+		void *slot;
+		if(paths[i] == NULL) {
+			/* nothing to look for */
+			alias[i] = i;
+			continue;
+		}
+		slot = _pacman_hash_get(slots, paths[i]);
+		if(slot == NULL) {
+			_pacman_hash_add(slots, paths[i], (void *)(long)(i + 1));
+			alias[i] = i;
+		} else {
+			alias[i] = (long)slot - 1;
+		}
+	}
+
+	/* the index is only written under the database lock, a read-only query
+	 * uses it as it is or reads the file lists */
+	locked = _pacman_db_owners_lock();
+	map = _pacman_db_owners_load(db, locked != -1);
+	if(map != NULL && _pacman_db_owners_lookup(db, map, paths, count, alias, slots, owners) == -1) {
+		_pacman_log(PM_LOG_WARNING, _("owners index of '%s' is corrupted"), db->treename);
+		_pacman_db_owners_unmap(map);
+		map = NULL;
+		if(locked != -1) {
+			_pacman_db_owners_invalidate(db);
+		}
+		for(i = 0; i < count; i++) {
+			FREELISTPTR(owners[i]);
+		}
+	}
+	if(map == NULL) {
+		_pacman_db_owners_scancache(db, slots, owners);
+	} else {
+		if(locked != -1 && (map->journalrecs >= OWNERS_JOURNAL_RECS ||
+			map->journalend - map->journal >= OWNERS_JOURNAL_SIZE)) {
+			_pacman_db_owners_compact(db, map);
+		}
+		_pacman_db_owners_unmap(map);
+	}
+	_pacman_db_owners_unlock(locked);
+
+	for(i = 0; i < count; i++) {
+		if(alias[i] != i) {
+			for(lp = owners[alias[i]]; lp; lp = lp->next) {
+				owners[i] = _pacman_list_add(owners[i], lp->data);
+			}
+		}
+		if(owners[i] != NULL) {
+			found++;
+		}
+	}
+	FREEHASH(slots);
+	FREE(alias);
+	return(found);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,40 @@
+/*
+ *  owners.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_OWNERS_H
+#define _PACMAN_OWNERS_H
+
+#include "db.h"
+
+#define OWNERS_EXT ".owners"
+
+/* Updates of the owners index */
+#define PM_OWNERS_STAMP  0 /* the db directory changed, the file lists did not */
+#define PM_OWNERS_ADD    1 /* the file list of the package was written */
+#define PM_OWNERS_REMOVE 2 /* the package was removed */
+
+void _pacman_db_owners_check(pmdb_t *db);
+void _pacman_db_owners_update(pmdb_t *db, pmpkg_t *info, int op);
+void _pacman_db_owners_invalidate(pmdb_t *db);
+int _pacman_db_owners_find(pmdb_t *db, const char **paths, int count, pmlist_t **owners);
+
+#endif /* _PACMAN_OWNERS_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <fcntl.h>
 #include <string.h>
+#include <ctype.h>
 #include <libintl.h>
 #include <locale.h>
 #include <sys/utsname.h>
@@ -40,8 +41,39 @@
 #include "handle.h"
 #include "cache.h"
 #include "package.h"
+#include "pool.h"
+#include "path.h"
+#include "owners.h"
+#include "versioncmp.h"
 #include "pacman.h"
 
+const pmpkgcold_t _pacman_pkg_nocold = { "", "", "", "", "", "", "", "", NULL, NULL };
+
+/* Returns the copy of str shared by all packages */
+static char *_pacman_pkg_intern(const char *str)
+{
+	if(str == NULL || str[0] == '\0') {
+		return("");
+	}
+	if(handle->strings == NULL && (handle->strings = _pacman_pool_new(0)) == NULL) {
+		return(NULL);
+	}
+	return(_pacman_pool_intern(handle->strings, str));
+}
+
+static void _pacman_pkg_init(pmpkg_t *pkg, const char *name, const char *version)
+{
+	memset(pkg, 0, sizeof(pmpkg_t));
+	if((pkg->name = _pacman_pkg_intern(name)) == NULL) {
+		pkg->name = "";
+	}
+	if((pkg->version = _pacman_pkg_intern(version)) == NULL) {
+		pkg->version = "";
+	}
+	pkg->arch           = "";
+	pkg->reason         = PM_PKG_REASON_EXPLICIT;
+}
+
 pmpkg_t *_pacman_pkg_new(const char *name, const char *version)
 {
 	pmpkg_t* pkg = NULL;
@@ -49,47 +81,24 @@ pmpkg_t *_pacman_pkg_new(const char *name, const char *version)
 	if((pkg = (pmpkg_t *)malloc(sizeof(pmpkg_t))) == NULL) {
 		RET_ERR(PM_ERR_MEMORY, (pmpkg_t *)-1);
 	}
+	_pacman_pkg_init(pkg, name, version);
 
-	if(name && name[0] != 0) {
-		STRNCPY(pkg->name, name, PKG_NAME_LEN);
-	} else {
-		pkg->name[0]        = '\0';
+	return(pkg);
+}
+
+/* Same as _pacman_pkg_new(), with the record allocated from pool: it is
+ * released with the pool, _pacman_pkg_free() only releases the lists that
+ * do not come from the pool.
+ */
+pmpkg_t *_pacman_pkg_new_pooled(pmpool_t *pool, const char *name, const char *version)
+{
+	pmpkg_t* pkg = NULL;
+
+	if((pkg = _pacman_pool_alloc(pool, sizeof(pmpkg_t))) == NULL) {
+		return(NULL);
 	}
-	if(version && version[0] != 0) {
-		STRNCPY(pkg->version, version, PKG_VERSION_LEN);
-	} else {
-		pkg->version[0]     = '\0';
-	}
-	pkg->desc[0]        = '\0';
-	pkg->url[0]         = '\0';
-	pkg->license        = NULL;
-	pkg->desc_localized = NULL;
-	pkg->builddate[0]   = '\0';
-	pkg->buildtype[0]   = '\0';
-	pkg->installdate[0] = '\0';
-	pkg->packager[0]    = '\0';
-	pkg->md5sum[0]      = '\0';
-	pkg->sha1sum[0]     = '\0';
-	pkg->arch[0]        = '\0';
-	pkg->size           = 0;
-	pkg->usize          = 0;
-	pkg->scriptlet      = 0;
-	pkg->force          = 0;
-	pkg->stick          = 0;
-	pkg->reason         = PM_PKG_REASON_EXPLICIT;
-	pkg->requiredby     = NULL;
-	pkg->conflicts      = NULL;
-	pkg->files          = NULL;
-	pkg->backup         = NULL;
-	pkg->depends        = NULL;
-	pkg->removes        = NULL;
-	pkg->groups         = NULL;
-	pkg->provides       = NULL;
-	pkg->replaces       = NULL;
-	/* internal */
-	pkg->origin         = 0;
-	pkg->data           = NULL;
-	pkg->infolevel      = 0;
+	_pacman_pkg_init(pkg, name, version);
+	pkg->pool = pool;
 
 	return(pkg);
 }
@@ -102,28 +111,29 @@ pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg)
 		return(NULL);
 	}
 
-	STRNCPY(newpkg->name, pkg->name, PKG_NAME_LEN);
-	STRNCPY(newpkg->version, pkg->version, PKG_VERSION_LEN);
-	STRNCPY(newpkg->desc, pkg->desc, PKG_DESC_LEN);
-	STRNCPY(newpkg->url, pkg->url, PKG_URL_LEN);
-	STRNCPY(newpkg->builddate, pkg->builddate, PKG_DATE_LEN);
-	STRNCPY(newpkg->buildtype, pkg->buildtype, PKG_DATE_LEN);
-	STRNCPY(newpkg->installdate, pkg->installdate, PKG_DATE_LEN);
-	STRNCPY(newpkg->packager, pkg->packager, PKG_PACKAGER_LEN);
-	STRNCPY(newpkg->md5sum, pkg->md5sum, PKG_MD5SUM_LEN);
-	STRNCPY(newpkg->sha1sum, pkg->sha1sum, PKG_SHA1SUM_LEN);
-	STRNCPY(newpkg->arch, pkg->arch, PKG_ARCH_LEN);
+	newpkg->name       = pkg->name;
+	newpkg->version    = pkg->version;
+	newpkg->arch       = pkg->arch;
+	newpkg->cold       = NULL;
+	if(pkg->cold) {
+		if((newpkg->cold = _pacman_malloc(sizeof(pmpkgcold_t))) == NULL) {
+			free(newpkg);
+			return(NULL);
+		}
+		*newpkg->cold = *pkg->cold;
+		newpkg->cold->license = _pacman_list_strdup(pkg->cold->license);
+		newpkg->cold->desc_localized = _pacman_list_strdup(pkg->cold->desc_localized);
+	}
 	newpkg->size       = pkg->size;
 	newpkg->usize      = pkg->usize;
 	newpkg->force      = pkg->force;
 	newpkg->stick      = pkg->stick;
 	newpkg->scriptlet  = pkg->scriptlet;
 	newpkg->reason     = pkg->reason;
-	newpkg->license    = _pacman_list_strdup(pkg->license);
-	newpkg->desc_localized = _pacman_list_strdup(pkg->desc_localized);
+	newpkg->date       = pkg->date;
 	newpkg->requiredby = _pacman_list_strdup(pkg->requiredby);
 	newpkg->conflicts  = _pacman_list_strdup(pkg->conflicts);
-	newpkg->files      = _pacman_list_strdup(pkg->files);
+	newpkg->files      = _pacman_path_list_copy(pkg->files);
 	newpkg->backup     = _pacman_list_strdup(pkg->backup);
 	newpkg->depends    = _pacman_list_strdup(pkg->depends);
 	newpkg->removes    = _pacman_list_strdup(pkg->removes);
@@ -134,6 +144,26 @@ pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg)
 	newpkg->origin     = pkg->origin;
 	newpkg->data = (newpkg->origin == PKG_FROM_FILE) ? strdup(pkg->data) : pkg->data;
 	newpkg->infolevel  = pkg->infolevel;
+	newpkg->snapoff    = 0;
+	newpkg->depcache   = NULL;
+	newpkg->verkey     = NULL;
+	newpkg->pool       = NULL;
+	if(pkg->pool) {
+		/* the strings viewed in the pool do not outlive it */
+		_pacman_pkg_set(newpkg, PM_PKG_NAME, pkg->name);
+		_pacman_pkg_set(newpkg, PM_PKG_VERSION, pkg->version);
+		_pacman_pkg_set(newpkg, PM_PKG_ARCH, pkg->arch);
+		if(newpkg->cold) {
+			_pacman_pkg_set(newpkg, PM_PKG_DESC, pkg->cold->desc);
+			_pacman_pkg_set(newpkg, PM_PKG_URL, pkg->cold->url);
+			_pacman_pkg_set(newpkg, PM_PKG_BUILDDATE, pkg->cold->builddate);
+			_pacman_pkg_set(newpkg, PM_PKG_BUILDTYPE, pkg->cold->buildtype);
+			_pacman_pkg_set(newpkg, PM_PKG_INSTALLDATE, pkg->cold->installdate);
+			_pacman_pkg_set(newpkg, PM_PKG_PACKAGER, pkg->cold->packager);
+			_pacman_pkg_set(newpkg, PM_PKG_MD5SUM, pkg->cold->md5sum);
+			_pacman_pkg_set(newpkg, PM_PKG_SHA1SUM, pkg->cold->sha1sum);
+		}
+	}
 
 	return(newpkg);
 }
@@ -141,14 +171,39 @@ pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg)
 void _pacman_pkg_free(void *data)
 {
 	pmpkg_t *pkg = data;
+	pmpool_t *pool;
 
 	if(pkg == NULL) {
 		return;
 	}
 
-	FREELIST(pkg->license);
-	FREELIST(pkg->desc_localized);
-	FREELIST(pkg->files);
+	FREE(pkg->depcache);
+	FREE(pkg->verkey);
+	if((pool = pkg->pool) != NULL) {
+		/* only the lists read or modified after the record was loaded
+		 * have to be freed, the rest goes with the pool */
+		if(pkg->cold) {
+			FREEPOOLLIST(pool, pkg->cold->license);
+			FREEPOOLLIST(pool, pkg->cold->desc_localized);
+		}
+		FREEPOOLLISTPTR(pool, pkg->files);
+		FREEPOOLLIST(pool, pkg->backup);
+		FREEPOOLLIST(pool, pkg->depends);
+		FREEPOOLLIST(pool, pkg->removes);
+		FREEPOOLLIST(pool, pkg->conflicts);
+		FREEPOOLLIST(pool, pkg->requiredby);
+		FREEPOOLLIST(pool, pkg->groups);
+		FREEPOOLLIST(pool, pkg->provides);
+		FREEPOOLLIST(pool, pkg->replaces);
+		return;
+	}
+
+	if(pkg->cold) {
+		FREELIST(pkg->cold->license);
+		FREELIST(pkg->cold->desc_localized);
+		free(pkg->cold);
+	}
+	FREELISTPTR(pkg->files);
 	FREELIST(pkg->backup);
 	FREELIST(pkg->depends);
 	FREELIST(pkg->removes);
@@ -165,6 +220,155 @@ void _pacman_pkg_free(void *data)
 	return;
 }
 
+/* Returns list, or a malloc'ed copy of it when it belongs to the pool of
+ * pkg: the result can be modified with the usual list functions.
+ */
+pmlist_t *_pacman_pkg_editlist(pmpkg_t *pkg, pmlist_t *list)
+{
+	if(list && _pacman_pool_owns(pkg->pool, list)) {
+		/* the pooled copy stays in the pool until the cache is freed */
+		return(_pacman_list_strdup(list));
+	}
+	return(list);
+}
+
+/* Returns the descriptive fields of pkg for writing, allocating them (from
+ * the pool of pkg if any) on first use.
+ */
+pmpkgcold_t *_pacman_pkg_cold(pmpkg_t *pkg)
+{
+	if(pkg->cold == NULL) {
+		if(pkg->pool) {
+			pkg->cold = _pacman_pool_alloc(pkg->pool, sizeof(pmpkgcold_t));
+		} else {
+			pkg->cold = _pacman_malloc(sizeof(pmpkgcold_t));
+		}
+		if(pkg->cold == NULL) {
+			return(NULL);
+		}
+		*pkg->cold = _pacman_pkg_nocold;
+	}
+	return(pkg->cold);
+}
+
+/* Returns the version of pkg split by _pacman_verkey(), computed on first use */
+static const char *_pacman_pkg_verkey(pmpkg_t *pkg)
+{
+	if(pkg->verkey == NULL) {
+		char key[PM_VERKEY_MAX];
+		size_t len = _pacman_verkey(pkg->version, key);
+
+		if((pkg->verkey = _pacman_malloc(len)) == NULL) {
+			return(NULL);
+		}
+		memcpy(pkg->verkey, key, len);
+	}
+	return(pkg->verkey);
+}
+
+/* Same as _pacman_versioncmp(pkg->version, verkey's version) */
+int _pacman_pkg_vercmpkey(pmpkg_t *pkg, const char *verkey)
+{
+	const char *key = _pacman_pkg_verkey(pkg);
+	char tmp[PM_VERKEY_MAX];
+
+	if(key == NULL) {
+		_pacman_verkey(pkg->version, tmp);
+		key = tmp;
+	}
+	return(_pacman_verkey_cmp(key, verkey));
+}
+
+/* Same as _pacman_versioncmp(pkg1->version, pkg2->version) */
+int _pacman_pkg_vercmp(pmpkg_t *pkg1, pmpkg_t *pkg2)
+{
+	const char *key = _pacman_pkg_verkey(pkg2);
+	char tmp[PM_VERKEY_MAX];
+
+	if(pkg1->version == pkg2->version) {
+		/* interned */
+		return(0);
+	}
+	if(key == NULL) {
+		_pacman_verkey(pkg2->version, tmp);
+		key = tmp;
+	}
+	return(_pacman_pkg_vercmpkey(pkg1, key));
+}
+
+/* Sets the string field parm (one of the PM_PKG_* of _pacman_pkg_getinfo())
+ * of pkg to the interned copy of str, or to str itself when it belongs to
+ * the pool of pkg.
+ */
+int _pacman_pkg_set(pmpkg_t *pkg, unsigned char parm, const char *str)
+{
+	pmpkgcold_t *cold = NULL;
+	char **field;
+	char *value;
+
+	switch(parm) {
+		case PM_PKG_NAME:    field = &pkg->name; break;
+		case PM_PKG_VERSION: field = &pkg->version; FREE(pkg->verkey); break;
+		case PM_PKG_ARCH:    field = &pkg->arch; break;
+		default:
+			if((cold = _pacman_pkg_cold(pkg)) == NULL) {
+				RET_ERR(PM_ERR_MEMORY, -1);
+			}
+			switch(parm) {
+				case PM_PKG_DESC:        field = &cold->desc; break;
+				case PM_PKG_URL:         field = &cold->url; break;
+				case PM_PKG_BUILDDATE:   field = &cold->builddate; break;
+				case PM_PKG_BUILDTYPE:   field = &cold->buildtype; break;
+				case PM_PKG_INSTALLDATE: field = &cold->installdate; break;
+				case PM_PKG_PACKAGER:    field = &cold->packager; break;
+				case PM_PKG_MD5SUM:      field = &cold->md5sum; break;
+				case PM_PKG_SHA1SUM:     field = &cold->sha1sum; break;
+				default:
+					RET_ERR(PM_ERR_WRONG_ARGS, -1);
+			}
+		break;
+	}
+	if(str && str[0] != '\0' && _pacman_pool_owns(pkg->pool, str)) {
+		/* a view on the record the package was loaded from */
+		value = (char *)str;
+	} else if((value = _pacman_pkg_intern(str)) == NULL) {
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+	*field = value;
+
+	return(0);
+}
+
+/* Picks the description matching the current language from
+ * desc_localized, falling back to the first (untranslated) entry.
+ */
+void _pacman_pkg_localize_desc(pmpkg_t *pkg)
+{
+	pmlist_t *i;
+	size_t len = strlen(handle->language);
+	const char *desc;
+	char *str;
+
+	if(PKG_COLD(pkg)->desc_localized == NULL) {
+		if(pkg->cold) {
+			pkg->cold->desc = "";
+		}
+		return;
+	}
+	desc = pkg->cold->desc_localized->data;
+	for(i = pkg->cold->desc_localized; i; i = i->next) {
+		if(!strncmp(i->data, handle->language, len) && *((char *)i->data+len) == ' ') {
+			desc = (char *)i->data+len+1;
+		}
+	}
+	if(desc[0] == '\0' || (!isspace((int)desc[0]) && !isspace((int)desc[strlen(desc)-1]))) {
+		_pacman_pkg_set(pkg, PM_PKG_DESC, desc);
+	} else if((str = strdup(desc)) != NULL) {
+		_pacman_pkg_set(pkg, PM_PKG_DESC, _pacman_strtrim(str));
+		free(str);
+	}
+}
+
 /* Helper function for comparing packages
  */
 int _pacman_pkg_cmp(const void *p1, const void *p2)
@@ -177,21 +381,14 @@ int _pacman_pkg_cmp(const void *p1, const void *p2)
  * Returns: 0 on success, 1 on error
  *
  */
-static int parse_descfile(char *descfile, pmpkg_t *info, int output)
+static int parse_descfile(pmreader_t *reader, pmpkg_t *info, int output)
 {
-	FILE* fp = NULL;
 	char line[PATH_MAX];
 	char* ptr = NULL;
 	char* key = NULL;
 	int linenum = 0;
 
-	if((fp = fopen(descfile, "r")) == NULL) {
-		_pacman_log(PM_LOG_ERROR, _("could not open file %s"), descfile);
-		return(-1);
-	}
-
-	while(!feof(fp)) {
-		fgets(line, PATH_MAX, fp);
+	while(_pacman_reader_fgets(reader, line, PATH_MAX)) {
 		linenum++;
 		_pacman_strtrim(line);
 		if(strlen(line) == 0 || line[0] == '#') {
@@ -210,32 +407,40 @@ static int parse_descfile(char *descfile, pmpkg_t *info, int output)
 			key = _pacman_strtoupper(key);
 			_pacman_strtrim(ptr);
 			if(!strcmp(key, "PKGNAME")) {
-				STRNCPY(info->name, ptr, sizeof(info->name));
+				_pacman_pkg_set(info, PM_PKG_NAME, ptr);
 			} else if(!strcmp(key, "PKGVER")) {
-				STRNCPY(info->version, ptr, sizeof(info->version));
+				_pacman_pkg_set(info, PM_PKG_VERSION, ptr);
 			} else if(!strcmp(key, "PKGDESC")) {
-				info->desc_localized = _pacman_list_add(info->desc_localized, strdup(ptr));
-				if(_pacman_list_count(info->desc_localized) == 1) {
-					STRNCPY(info->desc, ptr, sizeof(info->desc));
+				pmpkgcold_t *cold = _pacman_pkg_cold(info);
+				if(cold == NULL) {
+					return(-1);
+				}
+				cold->desc_localized = _pacman_list_add(cold->desc_localized, strdup(ptr));
+				if(_pacman_list_count(cold->desc_localized) == 1) {
+					_pacman_pkg_set(info, PM_PKG_DESC, ptr);
 				} else if (!strncmp(ptr, handle->language, strlen(handle->language))) {
-					STRNCPY(info->desc, ptr+strlen(handle->language)+1, sizeof(info->desc));
+					_pacman_pkg_set(info, PM_PKG_DESC, ptr+strlen(handle->language)+1);
 				}
 			} else if(!strcmp(key, "GROUP")) {
 				info->groups = _pacman_list_add(info->groups, strdup(ptr));
 			} else if(!strcmp(key, "URL")) {
-				STRNCPY(info->url, ptr, sizeof(info->url));
+				_pacman_pkg_set(info, PM_PKG_URL, ptr);
 			} else if(!strcmp(key, "LICENSE")) {
-				info->license = _pacman_list_add(info->license, strdup(ptr));
+				pmpkgcold_t *cold = _pacman_pkg_cold(info);
+				if(cold == NULL) {
+					return(-1);
+				}
+				cold->license = _pacman_list_add(cold->license, strdup(ptr));
 			} else if(!strcmp(key, "BUILDDATE")) {
-				STRNCPY(info->builddate, ptr, sizeof(info->builddate));
+				_pacman_pkg_set(info, PM_PKG_BUILDDATE, ptr);
 			} else if(!strcmp(key, "BUILDTYPE")) {
-				STRNCPY(info->buildtype, ptr, sizeof(info->buildtype));
+				_pacman_pkg_set(info, PM_PKG_BUILDTYPE, ptr);
 			} else if(!strcmp(key, "INSTALLDATE")) {
-				STRNCPY(info->installdate, ptr, sizeof(info->installdate));
+				_pacman_pkg_set(info, PM_PKG_INSTALLDATE, ptr);
 			} else if(!strcmp(key, "PACKAGER")) {
-				STRNCPY(info->packager, ptr, sizeof(info->packager));
+				_pacman_pkg_set(info, PM_PKG_PACKAGER, ptr);
 			} else if(!strcmp(key, "ARCH")) {
-				STRNCPY(info->arch, ptr, sizeof(info->arch));
+				_pacman_pkg_set(info, PM_PKG_ARCH, ptr);
 			} else if(!strcmp(key, "SIZE")) {
 				char tmp[32];
 				STRNCPY(tmp, ptr, sizeof(tmp));
@@ -261,10 +466,7 @@ static int parse_descfile(char *descfile, pmpkg_t *info, int output)
 					info->name[0] != '\0' ? info->name : "error", linenum);
 			}
 		}
-		line[0] = '\0';
 	}
-	fclose(fp);
-	unlink(descfile);
 
 	return(0);
 }
@@ -278,6 +480,7 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 	int scriptcheck = 0;
 	register struct archive *archive;
 	struct archive_entry *entry;
+	pmreader_t *reader = NULL;
 	struct utsname name;
 	pmpkg_t *info = NULL;
 
@@ -295,7 +498,9 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 		RET_ERR(PM_ERR_PKG_OPEN, NULL);
 
 	info = _pacman_pkg_new(NULL, NULL);
-	if(info == NULL) {
+	reader = _pacman_reader_new(archive);
+	if(info == NULL || reader == NULL) {
+		FREEPKG(info);
 		archive_read_finish (archive);
 		RET_ERR(PM_ERR_MEMORY, NULL);
 	}
@@ -306,45 +511,27 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 			break;
 		}
 		if(!strcmp(archive_entry_pathname (entry), ".PKGINFO")) {
-			char *descfile;
-			int fd;
-
-			/* extract this file into /tmp. it has info for us */
-			descfile = strdup("/tmp/pacman_XXXXXX");
-			fd = mkstemp(descfile);
-			archive_read_data_into_fd (archive, fd);
-			/* parse the info file */
-			if(parse_descfile(descfile, info, 0) == -1) {
+			/* parse the info file straight from the archive */
+			_pacman_reader_reset(reader);
+			if(parse_descfile(reader, info, 0) == -1) {
 				_pacman_log(PM_LOG_ERROR, _("could not parse the package description file"));
 				pm_errno = PM_ERR_PKG_INVALID;
-				unlink(descfile);
-				FREE(descfile);
-				close(fd);
 				goto error;
 			}
 			if(!strlen(info->name)) {
 				_pacman_log(PM_LOG_ERROR, _("missing package name in %s"), pkgfile);
 				pm_errno = PM_ERR_PKG_INVALID;
-				unlink(descfile);
-				FREE(descfile);
-				close(fd);
 				goto error;
 			}
 			if(!strlen(info->version)) {
 				_pacman_log(PM_LOG_ERROR, _("missing package version in %s"), pkgfile);
 				pm_errno = PM_ERR_PKG_INVALID;
-				unlink(descfile);
-				FREE(descfile);
-				close(fd);
 				goto error;
 			}
 			if(handle->trans && !(handle->trans->flags & PM_TRANS_FLAG_NOARCH)) {
 				if(!strlen(info->arch)) {
 					_pacman_log(PM_LOG_ERROR, _("missing package architecture in %s"), pkgfile);
 					pm_errno = PM_ERR_PKG_INVALID;
-					unlink(descfile);
-					FREE(descfile);
-					close(fd);
 					goto error;
 				}
 
@@ -352,48 +539,41 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 				if(strncmp(name.machine, info->arch, strlen(info->arch))) {
 					_pacman_log(PM_LOG_ERROR, _("wrong package architecture in %s"), pkgfile);
 					pm_errno = PM_ERR_WRONG_ARCH;
-					unlink(descfile);
-					FREE(descfile);
-					close(fd);
 					goto error;
 				}
 			}
 			config = 1;
-			unlink(descfile);
-			FREE(descfile);
-			close(fd);
 			continue;
 		} else if(!strcmp(archive_entry_pathname (entry), "._install") || !strcmp(archive_entry_pathname (entry),  ".INSTALL")) {
 			info->scriptlet = 1;
 			scriptcheck = 1;
 		} else if(!strcmp(archive_entry_pathname (entry), ".FILELIST")) {
 			/* Build info->files from the filelist */
-			FILE *fp;
-			char *fn;
-			char *str;
-			int fd;
+			const char *str;
+			size_t len;
 
-			if((str = (char *)malloc(PATH_MAX)) == NULL) {
-				RET_ERR(PM_ERR_MEMORY, (pmpkg_t *)-1);
-			}
-			fn = strdup("/tmp/pacman_XXXXXX");
-			fd = mkstemp(fn);
-			archive_read_data_into_fd (archive,fd);
-			fp = fopen(fn, "r");
-			while(!feof(fp)) {
-				if(fgets(str, PATH_MAX, fp) == NULL) {
-					continue;
+			_pacman_reader_reset(reader);
+			while((str = _pacman_reader_getline(reader, &len)) != NULL) {
+				char path[PATH_MAX];
+				const char *file;
+
+				while(len && isspace((int)*str)) {
+					str++;
+					len--;
 				}
-				_pacman_strtrim(str);
-				info->files = _pacman_list_add(info->files, strdup(str));
-			}
-			FREE(str);
-			fclose(fp);
-			if(unlink(fn)) {
-				_pacman_log(PM_LOG_WARNING, _("could not remove tempfile %s"), fn);
+				while(len && isspace((int)str[len-1])) {
+					len--;
+				}
+				if(len >= PATH_MAX) {
+					len = PATH_MAX - 1;
+				}
+				memcpy(path, str, len);
+				path[len] = '\0';
+				if((file = _pacman_path_intern(path)) == NULL) {
+					goto error;
+				}
+				info->files = _pacman_list_add(info->files, (char *)file);
 			}
-			FREE(fn);
-			close(fd);
 			filelist = 1;
 			continue;
 		} else {
@@ -401,7 +581,7 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 			if(!filelist) {
 				/* no .FILELIST present in this package..  build the filelist the */
 				/* old-fashioned way, one at a time */
-				expath = strdup(archive_entry_pathname (entry));
+				expath = (char *)_pacman_path_intern(archive_entry_pathname (entry));
 				info->files = _pacman_list_add(info->files, expath);
 			}
 		}
@@ -413,6 +593,7 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 		expath = NULL;
 	}
 	archive_read_finish (archive);
+	_pacman_reader_free(reader);
 
 	if(!config) {
 		_pacman_log(PM_LOG_ERROR, _("missing package info file in %s"), pkgfile);
@@ -430,6 +611,7 @@ error:
 	FREEPKG(info);
 	if(!ret) {
 		archive_read_finish (archive);
+		_pacman_reader_free(reader);
 	}
 	pm_errno = PM_ERR_PKG_CORRUPTED;
 
@@ -565,23 +747,23 @@ void *_pacman_pkg_getinfo(pmpkg_t *pkg, unsigned char parm)
 	switch(parm) {
 		case PM_PKG_NAME:        data = pkg->name; break;
 		case PM_PKG_VERSION:     data = pkg->version; break;
-		case PM_PKG_DESC:        data = pkg->desc; break;
+		case PM_PKG_DESC:        data = PKG_COLD(pkg)->desc; break;
 		case PM_PKG_GROUPS:      data = pkg->groups; break;
-		case PM_PKG_URL:         data = pkg->url; break;
+		case PM_PKG_URL:         data = PKG_COLD(pkg)->url; break;
 		case PM_PKG_ARCH:        data = pkg->arch; break;
-		case PM_PKG_BUILDDATE:   data = pkg->builddate; break;
-		case PM_PKG_BUILDTYPE:   data = pkg->buildtype; break;
-		case PM_PKG_INSTALLDATE: data = pkg->installdate; break;
-		case PM_PKG_PACKAGER:    data = pkg->packager; break;
+		case PM_PKG_BUILDDATE:   data = PKG_COLD(pkg)->builddate; break;
+		case PM_PKG_BUILDTYPE:   data = PKG_COLD(pkg)->buildtype; break;
+		case PM_PKG_INSTALLDATE: data = PKG_COLD(pkg)->installdate; break;
+		case PM_PKG_PACKAGER:    data = PKG_COLD(pkg)->packager; break;
 		case PM_PKG_SIZE:        data = (void *)(long)pkg->size; break;
 		case PM_PKG_USIZE:       data = (void *)(long)pkg->usize; break;
 		case PM_PKG_REASON:      data = (void *)(long)pkg->reason; break;
-		case PM_PKG_LICENSE:     data = pkg->license; break;
+		case PM_PKG_LICENSE:     data = PKG_COLD(pkg)->license; break;
 		case PM_PKG_REPLACES:    data = pkg->replaces; break;
 		case PM_PKG_FORCE:       data = (void *)(long)pkg->force; break;
 		case PM_PKG_STICK:       data = (void *)(long)pkg->stick; break;
-		case PM_PKG_MD5SUM:      data = pkg->md5sum; break;
-		case PM_PKG_SHA1SUM:     data = pkg->sha1sum; break;
+		case PM_PKG_MD5SUM:      data = PKG_COLD(pkg)->md5sum; break;
+		case PM_PKG_SHA1SUM:     data = PKG_COLD(pkg)->sha1sum; break;
 		case PM_PKG_DEPENDS:     data = pkg->depends; break;
 		case PM_PKG_REMOVES:     data = pkg->removes; break;
 		case PM_PKG_REQUIREDBY:  data = pkg->requiredby; break;
@@ -599,12 +781,13 @@ void *_pacman_pkg_getinfo(pmpkg_t *pkg, unsigned char parm)
 	return(data);
 }
 
-pmlist_t *_pacman_pkg_getowners(char *filename)
+/* Turns filename into a path of the file lists, in rpath.
+ * Returns NULL if it can not be owned by a package.
+ */
+static const char *_pacman_pkg_ownerpath(const char *filename, char *rpath)
 {
 	struct stat buf;
-	int gotcha = 0;
-	char rpath[PATH_MAX];
-	pmlist_t *lp, *ret = NULL;
+	size_t rootlen = strlen(handle->root);
 
 	if(stat(filename, &buf) == -1 || realpath(filename, rpath) == NULL) {
 		RET_ERR(PM_ERR_PKG_OPEN, NULL);
@@ -616,35 +799,69 @@ pmlist_t *_pacman_pkg_getowners(char *filename)
 		rpath[strlen(rpath)+1] = '\0';
 		rpath[strlen(rpath)] = '/';
 	}
+	if(strncmp(rpath, handle->root, rootlen)) {
+		RET_ERR(PM_ERR_NO_OWNER, NULL);
+	}
+	return(rpath + rootlen);
+}
 
-	for(lp = _pacman_db_get_pkgcache(handle->db_local); lp; lp = lp->next) {
-		pmpkg_t *info;
-		pmlist_t *i;
-
-		info = lp->data;
-
-		for(i = _pacman_pkg_getinfo(info, PM_PKG_FILES); i; i = i->next) {
-			char path[PATH_MAX];
+pmlist_t *_pacman_pkg_getowners(char *filename)
+{
+	char rpath[PATH_MAX];
+	const char *file;
+	pmlist_t *ret;
 
-			snprintf(path, PATH_MAX, "%s%s", handle->root, (char *)i->data);
-			if(!strcmp(path, rpath)) {
-				ret = _pacman_list_add(ret, info);
-				if(rpath[strlen(rpath)-1] != '/') {
-					/* we are searching for a file and multiple packages won't contain
-					 * the same file */
-					return(ret);
-				}
-				gotcha = 1;
-			}
-		}
+	if((file = _pacman_pkg_ownerpath(filename, rpath)) == NULL) {
+		return(NULL);
+	}
+	if(_pacman_db_owners_find(handle->db_local, &file, 1, &ret) == -1) {
+		return(NULL);
 	}
-	if(!gotcha) {
+	if(ret == NULL) {
 		RET_ERR(PM_ERR_NO_OWNER, NULL);
 	}
 
 	return(ret);
 }
 
+/* Looks for the owners of count files with one query of the owners index.
+ * owners[i] is set to the packages owning filenames[i], or to NULL.
+ * Returns the number of owned files, or -1 on error.
+ */
+int _pacman_pkg_getowners_list(char **filenames, int count, pmlist_t **owners)
+{
+	char rpath[PATH_MAX];
+	const char **files, *file;
+	pmpool_t *pool;
+	int i, ret;
+
+	if(count <= 0) {
+		return(0);
+	}
+	/* the resolved paths are kept at their own length */
+	pool = _pacman_pool_new(0);
+	files = _pacman_malloc(count * sizeof(char *));
+	if(pool == NULL || files == NULL) {
+		FREEPOOL(pool);
+		FREE(files);
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+	for(i = 0; i < count; i++) {
+		/* NULL when no package can own it */
+		files[i] = NULL;
+		if((file = _pacman_pkg_ownerpath(filenames[i], rpath)) != NULL &&
+			(files[i] = _pacman_pool_strdup(pool, file)) == NULL) {
+			FREEPOOL(pool);
+			FREE(files);
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+	}
+	ret = _pacman_db_owners_find(handle->db_local, files, count, owners);
+	FREEPOOL(pool);
+	FREE(files);
+	return(ret);
+}
+
 void _pacman_pkg_filename(char *str, size_t size, const pmpkg_t *pkg)
 {
 	snprintf(str, size, "%s-%s-%s%s",
@@ -38,51 +38,62 @@ enum {
 #define PKG_NAME_LEN     256
 #define PKG_VERSION_LEN  64
 #define PKG_FULLNAME_LEN (PKG_NAME_LEN-1)+1+(PKG_VERSION_LEN-1)+1
-#define PKG_DESC_LEN     512
-#define PKG_URL_LEN      256
-#define PKG_DATE_LEN     32
-#define PKG_TYPE_LEN     32
-#define PKG_PACKAGER_LEN 64
-#define PKG_MD5SUM_LEN   33
-#define PKG_SHA1SUM_LEN  41
-#define PKG_ARCH_LEN     32
 
+/* Descriptive fields, only needed to display or record a package: they are
+ * allocated on first use, see _pacman_pkg_cold().
+ */
+typedef struct __pmpkgcold_t {
+	char *desc;
+	char *url;
+	char *builddate;
+	char *buildtype;
+	char *installdate;
+	char *packager;
+	char *md5sum;
+	char *sha1sum;
+	pmlist_t *desc_localized;
+	pmlist_t *license;
+} pmpkgcold_t;
+
+/* The strings of a package are interned (see _pacman_pkg_set()): they are
+ * shared between packages and must never be modified in place.
+ */
 typedef struct __pmpkg_t {
-	char name[PKG_NAME_LEN];
-	char version[PKG_VERSION_LEN];
-	char desc[PKG_DESC_LEN];
-	char url[PKG_URL_LEN];
-	char builddate[PKG_DATE_LEN];
-	char buildtype[PKG_TYPE_LEN];
-	char installdate[PKG_DATE_LEN];
-	char packager[PKG_PACKAGER_LEN];
-	char md5sum[PKG_MD5SUM_LEN];
-	char sha1sum[PKG_SHA1SUM_LEN];
-	char arch[PKG_ARCH_LEN];
-	unsigned long size;
-	unsigned long usize;
-	unsigned char scriptlet;
+	/* what dependency resolution looks at comes first */
+	char *name;
+	char *version;
+	pmlist_t *depends;
+	pmlist_t *provides;
+	pmlist_t *conflicts;
+	pmlist_t *replaces;
+	pmlist_t *requiredby;
+	unsigned char origin;
+	unsigned char infolevel;
 	unsigned char force;
 	unsigned char stick;
-	time_t date;
 	unsigned char reason;
-	pmlist_t *desc_localized;
-	pmlist_t *license;
-	pmlist_t *replaces;
+	unsigned char scriptlet;
+	void *data;
+	char *arch;
+	unsigned long size;
+	unsigned long usize;
+	time_t date;
 	pmlist_t *groups;
-	pmlist_t *files;
-	pmlist_t *backup;
-	pmlist_t *depends;
 	pmlist_t *removes;
-	pmlist_t *requiredby;
-	pmlist_t *conflicts;
-	pmlist_t *provides;
+	pmlist_t *files; /* interned paths (see path.c), only the nodes are owned */
+	pmlist_t *backup;
+	pmpkgcold_t *cold;
 	/* internal */
-	unsigned char origin;
-	void *data;
-	unsigned char infolevel;
+	unsigned long snapoff; /* file list offset in the db snapshot, 0 if none */
+	struct __pmdepcache_t *depcache; /* see _pacman_parsedeps() */
+	char *verkey; /* see _pacman_pkg_vercmp() */
+	struct __pmpool_t *pool; /* owner of the record if not malloc'ed */
 } pmpkg_t;
 
+/* Read access to the descriptive fields, empty when never set */
+extern const pmpkgcold_t _pacman_pkg_nocold;
+#define PKG_COLD(p) ((p)->cold ? (const pmpkgcold_t *)(p)->cold : &_pacman_pkg_nocold)
+
 #define FREEPKG(p) \
 do { \
 	if(p) { \
@@ -94,14 +105,22 @@ do { \
 #define FREELISTPKGS(p) _FREELIST(p, _pacman_pkg_free)
 
 pmpkg_t* _pacman_pkg_new(const char *name, const char *version);
+pmpkg_t *_pacman_pkg_new_pooled(struct __pmpool_t *pool, const char *name, const char *version);
 pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg);
 void _pacman_pkg_free(void *data);
+pmlist_t *_pacman_pkg_editlist(pmpkg_t *pkg, pmlist_t *list);
+pmpkgcold_t *_pacman_pkg_cold(pmpkg_t *pkg);
+int _pacman_pkg_set(pmpkg_t *pkg, unsigned char parm, const char *str);
+void _pacman_pkg_localize_desc(pmpkg_t *pkg);
 int _pacman_pkg_cmp(const void *p1, const void *p2);
+int _pacman_pkg_vercmp(pmpkg_t *pkg1, pmpkg_t *pkg2);
+int _pacman_pkg_vercmpkey(pmpkg_t *pkg, const char *verkey);
 pmpkg_t *_pacman_pkg_load(const char *pkgfile);
 pmpkg_t *_pacman_pkg_isin(const char *needle, pmlist_t *haystack);
 int _pacman_pkg_splitname(char *target, char *name, char *version, int witharch);
 void *_pacman_pkg_getinfo(pmpkg_t *pkg, unsigned char parm);
 pmlist_t *_pacman_pkg_getowners(char *filename);
+int _pacman_pkg_getowners_list(char **filenames, int count, pmlist_t **owners);
 
 void _pacman_pkg_filename(char *str, size_t size, const pmpkg_t *pkg);
 
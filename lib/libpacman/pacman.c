@@ -49,6 +49,7 @@
 #include "util.h"
 #include "db.h"
 #include "cache.h"
+#include "snapshot.h"
 #include "conflict.h"
 #include "backup.h"
 #include "add.h"
@@ -375,6 +376,7 @@ int pacman_db_update(int force, PM_DB *db)
 
 		/* Cache needs to be rebuild */
 		_pacman_db_free_pkgcache(db);
+		_pacman_db_snapshot_invalidate(db);
 
 		if(updated) {
 			_pacman_db_setlastupdate(db, newmtime);
@@ -497,6 +499,23 @@ pmlist_t *pacman_pkg_getowners(char *filename)
 	return(_pacman_pkg_getowners(filename));
 }
 
+/** Get the lists of packages that own each of the specified files
+ * @param filenames names of the files
+ * @param count number of files
+ * @param owners array of count lists, owners[i] is set to the list of
+ * packages owning filenames[i], or to NULL if no package owns it. The
+ * packages are the ones of the local database cache, do not free them.
+ * @return the number of owned files on success, -1 on error
+ */
+int pacman_pkg_getowners_list(char **filenames, int count, pmlist_t **owners)
+{
+	/* Sanity checks */
+	ASSERT(handle->db_local != NULL, RET_ERR(PM_ERR_DB_NULL, -1));
+	ASSERT(filenames != NULL && owners != NULL && count >= 0, RET_ERR(PM_ERR_WRONG_ARGS, -1));
+
+	return(_pacman_pkg_getowners_list(filenames, count, owners));
+}
+
 /** Create a package from a file.
  * @param filename location of the package tarball
  * @param pkg address of the package pointer
@@ -211,6 +211,7 @@ enum {
 
 void *pacman_pkg_getinfo(PM_PKG *pkg, unsigned char parm);
 PM_LIST *pacman_pkg_getowners(char *filename);
+int pacman_pkg_getowners_list(char **filenames, int count, PM_LIST **owners);
 int pacman_pkg_load(char *filename, PM_PKG **pkg);
 int pacman_pkg_free(PM_PKG *pkg);
 char *pacman_fetch_pkgurl(char *url);
@@ -307,7 +308,8 @@ enum {
 	PM_TRANS_EVT_SCRIPTLET_DONE,
 	PM_TRANS_EVT_PRINTURI,
 	PM_TRANS_EVT_RETRIEVE_START,
-	PM_TRANS_EVT_RETRIEVE_LOCAL
+	PM_TRANS_EVT_RETRIEVE_LOCAL,
+	PM_TRANS_EVT_DEPCYCLE /* data1: the PM_LIST of the packages in the cycle */
 };
 
 /* Transaction Conversations (ie, questions) */
@@ -0,0 +1,175 @@
+/*
+ *  path.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+/* pacman-g2 */
+#include "util.h"
+#include "list.h"
+#include "hash.h"
+#include "pool.h"
+#include "handle.h"
+#include "path.h"
+
+#define PATH_MINSLOTS 1024
+#define PATH_CHUNKSIZE (64 * 1024)
+
+/* The file lists of the packages (PM_PKG_FILES) hold paths of the store of
+ * the handle: the same file owned by several packages, or by the installed
+ * and the new version of a package, is stored once.  The lists only own
+ * their nodes, the paths live as long as the handle.
+ */
+static pmpathstore_t *_pacman_path_store(void)
+{
+	pmpathstore_t *store = handle->paths;
+
+	if(store == NULL) {
+		if((store = _pacman_zalloc(sizeof(pmpathstore_t))) == NULL) {
+			return(NULL);
+		}
+		store->size = PATH_MINSLOTS;
+		store->slots = _pacman_zalloc(store->size * sizeof(pmpath_t *));
+		store->pool = _pacman_pool_new(PATH_CHUNKSIZE);
+		if(store->slots == NULL || store->pool == NULL) {
+			_pacman_path_free(store);
+			return(NULL);
+		}
+		handle->paths = store;
+	}
+	return(store);
+}
+
+/* Returns the slot of path: the one holding its record, or the free one
+ * where it goes.
+ */
+static pmpath_t **_pacman_path_slot(pmpath_t **slots, unsigned long size, const char *path, unsigned int hash)
+{
+	unsigned long i = hash & (size - 1);
+
+	while(slots[i] && (slots[i]->hash != hash || strcmp(slots[i]->str, path))) {
+		i = (i + 1) & (size - 1);
+	}
+	return(&slots[i]);
+}
+
+/* Doubles the table: the records are placed again by the hash they keep */
+static int _pacman_path_grow(pmpathstore_t *store)
+{
+	unsigned long i, j, size = store->size * 2;
+	pmpath_t **slots = _pacman_zalloc(size * sizeof(pmpath_t *));
+
+	if(slots == NULL) {
+		return(-1);
+	}
+	for(i = 0; i < store->size; i++) {
+		if(store->slots[i] == NULL) {
+			continue;
+		}
+		for(j = store->slots[i]->hash & (size - 1); slots[j]; j = (j + 1) & (size - 1));
+		slots[j] = store->slots[i];
+	}
+	free(store->slots);
+	store->slots = slots;
+	store->size = size;
+	return(0);
+}
+
+/* Returns the copy of path held by the store, making one on first use */
+const char *_pacman_path_intern(const char *path)
+{
+	pmpathstore_t *store;
+	pmpath_t *rec, **slot;
+	unsigned int hash;
+	size_t len;
+
+	if(path == NULL || (store = _pacman_path_store()) == NULL) {
+		return(NULL);
+	}
+	hash = _pacman_hash_str(path);
+	slot = _pacman_path_slot(store->slots, store->size, path, hash);
+	if(*slot != NULL) {
+		return((*slot)->str);
+	}
+	/* keep a quarter of the slots free, for short probes */
+	if((store->count + 1) * 4 > store->size * 3) {
+		if(_pacman_path_grow(store) == -1) {
+			return(NULL);
+		}
+		slot = _pacman_path_slot(store->slots, store->size, path, hash);
+	}
+	len = strlen(path);
+	if((rec = _pacman_pool_alloc(store->pool, sizeof(pmpath_t) + len + 1)) == NULL) {
+		return(NULL);
+	}
+	rec->id = store->count + 1;
+	rec->flags = (len && path[len-1] == '/') ? PM_PATH_DIR : 0;
+	rec->hash = hash;
+	memcpy(rec->str, path, len + 1);
+	*slot = rec;
+	store->count++;
+	return(rec->str);
+}
+
+/* Returns the copy of path held by the store, or NULL if no package file
+ * list loaded so far has it.
+ */
+const char *_pacman_path_find(const char *path)
+{
+	pmpathstore_t *store = handle->paths;
+	pmpath_t *rec;
+
+	if(path == NULL || store == NULL ||
+		(rec = *_pacman_path_slot(store->slots, store->size, path, _pacman_hash_str(path))) == NULL) {
+		return(NULL);
+	}
+	return(rec->str);
+}
+
+/* Returns the number of paths in the store: their ids are not above it */
+unsigned int _pacman_path_count(void)
+{
+	return(handle->paths ? handle->paths->count : 0);
+}
+
+void _pacman_path_free(pmpathstore_t *store)
+{
+	if(store == NULL) {
+		return;
+	}
+	FREE(store->slots);
+	FREEPOOL(store->pool);
+	free(store);
+}
+
+/* Returns a copy of a list of paths, sharing the paths */
+pmlist_t *_pacman_path_list_copy(pmlist_t *list)
+{
+	pmlist_t *newlist = NULL;
+	pmlist_t *lp;
+
+	for(lp = list; lp; lp = lp->next) {
+		newlist = _pacman_list_add(newlist, lp->data);
+	}
+	return(newlist);
+}
+
+/* vim: set ts=2 sw=2 noet: */
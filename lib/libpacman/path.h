@@ -0,0 +1,77 @@
+/*
+ *  path.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_PATH_H
+#define _PACMAN_PATH_H
+
+#include <stddef.h>
+#include "list.h"
+
+/* Path flags */
+#define PM_PATH_DIR 0x01 /* the path ends with a slash */
+
+/* An interned path: the string handed out is the one of the record, so that
+ * its id and flags are found back from it.  The header takes 8 bytes.
+ */
+typedef struct __pmpath_t {
+	unsigned int id : 31; /* from 1 on, in interning order */
+	unsigned int flags : 1;
+	unsigned int hash; /* _pacman_hash_str() of the path */
+	char str[];
+} pmpath_t;
+
+/* The paths of the files of all packages, each stored once.  The records
+ * are indexed by an open addressing table of their own, probed with the
+ * hash they keep.
+ */
+typedef struct __pmpathstore_t {
+	pmpath_t **slots;
+	unsigned long size; /* of slots, a power of 2 */
+	struct __pmpool_t *pool;
+	unsigned int count;
+} pmpathstore_t;
+
+#define _PACMAN_PATH(s) ((const pmpath_t *)((const char *)(s) - offsetof(pmpath_t, str)))
+
+const char *_pacman_path_intern(const char *path);
+const char *_pacman_path_find(const char *path);
+unsigned int _pacman_path_count(void);
+void _pacman_path_free(pmpathstore_t *store);
+pmlist_t *_pacman_path_list_copy(pmlist_t *list);
+
+/* The id of an interned path */
+static inline unsigned int _pacman_path_id(const char *path)
+{
+	return(_PACMAN_PATH(path)->id);
+}
+
+static inline unsigned long _pacman_path_hash(const char *path)
+{
+	return(_PACMAN_PATH(path)->hash);
+}
+
+static inline int _pacman_path_isdir(const char *path)
+{
+	return(_PACMAN_PATH(path)->flags & PM_PATH_DIR);
+}
+
+#endif /* _PACMAN_PATH_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,182 @@
+/*
+ *  pool.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "util.h"
+#include "hash.h"
+#include "pool.h"
+
+#define POOL_ALIGN sizeof(void *)
+
+static pmpoolchunk_t *_pacman_pool_grow(pmpool_t *pool, size_t size)
+{
+	pmpoolchunk_t *chunk;
+
+	/* chunks double in size, so that there are few of them to look at
+	 * in _pacman_pool_owns() */
+	if(pool->chunks && pool->grow && pool->chunksize < 16 * 1024 * 1024) {
+		pool->chunksize *= 2;
+	}
+	if(size < pool->chunksize) {
+		size = pool->chunksize;
+	}
+	if((chunk = _pacman_malloc(sizeof(pmpoolchunk_t) + size)) == NULL) {
+		return(NULL);
+	}
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	pool->nchunks++;
+
+	return(chunk);
+}
+
+/* Returns a pool of chunks of chunksize bytes, or of chunks doubling in size
+ * from 64 kB if chunksize is 0.  The unused end of the last chunk is smaller
+ * with a fixed size, for pools never looked into by _pacman_pool_owns().
+ */
+pmpool_t *_pacman_pool_new(size_t chunksize)
+{
+	pmpool_t *pool = _pacman_zalloc(sizeof(pmpool_t));
+
+	if(pool == NULL) {
+		return(NULL);
+	}
+	pool->chunksize = chunksize ? chunksize : 64 * 1024;
+	pool->grow = (chunksize == 0);
+
+	return(pool);
+}
+
+void _pacman_pool_free(pmpool_t *pool)
+{
+	pmpoolchunk_t *chunk, *next;
+
+	if(pool == NULL) {
+		return;
+	}
+	FREEHASH(pool->strings);
+	for(chunk = pool->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	free(pool);
+}
+
+void *_pacman_pool_alloc(pmpool_t *pool, size_t size)
+{
+	pmpoolchunk_t *chunk = pool->chunks;
+	void *ptr;
+
+	size = (size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+	if(chunk == NULL || chunk->size - chunk->used < size) {
+		if((chunk = _pacman_pool_grow(pool, size)) == NULL) {
+			return(NULL);
+		}
+	}
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	pool->allocs++;
+	pool->bytes += size;
+
+	return(ptr);
+}
+
+char *_pacman_pool_strdup(pmpool_t *pool, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *ptr = _pacman_pool_alloc(pool, len);
+
+	if(ptr != NULL) {
+		memcpy(ptr, str, len);
+	}
+	return(ptr);
+}
+
+/* Returns the copy of str held by the pool, making one on first use: equal
+ * strings given to the same pool share their storage.
+ */
+char *_pacman_pool_intern(pmpool_t *pool, const char *str)
+{
+	char *ptr;
+
+	if(pool->strings == NULL && (pool->strings = _pacman_hash_new(0)) == NULL) {
+		return(NULL);
+	}
+	if((ptr = _pacman_hash_get(pool->strings, str)) != NULL) {
+		return(ptr);
+	}
+	if((ptr = _pacman_pool_strdup(pool, str)) == NULL) {
+		return(NULL);
+	}
+	if(_pacman_hash_add(pool->strings, ptr, ptr) == -1) {
+		return(NULL);
+	}
+	return(ptr);
+}
+
+/* Same as _pacman_list_add(), with a node taken from the pool.
+ * Such lists must never be given to _pacman_list_free() or
+ * _pacman_list_remove().
+ */
+pmlist_t *_pacman_pool_list_add(pmpool_t *pool, pmlist_t *list, void *data)
+{
+	pmlist_t *node = _pacman_pool_alloc(pool, sizeof(pmlist_t));
+
+	if(node == NULL) {
+		return(list);
+	}
+	node->data = data;
+	node->next = NULL;
+	node->last = NULL;
+	if(list == NULL) {
+		node->prev = NULL;
+		node->last = node;
+		return(node);
+	}
+	node->prev = list->last;
+	list->last->next = node;
+	list->last = node;
+
+	return(list);
+}
+
+int _pacman_pool_owns(pmpool_t *pool, const void *ptr)
+{
+	pmpoolchunk_t *chunk;
+
+	if(pool == NULL) {
+		return(0);
+	}
+	for(chunk = pool->chunks; chunk; chunk = chunk->next) {
+		if((const char *)ptr >= chunk->data && (const char *)ptr < chunk->data + chunk->used) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/* vim: set ts=2 sw=2 noet: */
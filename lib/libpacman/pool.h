@@ -0,0 +1,75 @@
+/*
+ *  pool.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_POOL_H
+#define _PACMAN_POOL_H
+
+#include "list.h"
+
+/* Bump allocator: memory is only given back when the whole pool is freed.
+ * It holds records whose lifetime is the one of a package cache, so that
+ * loading and freeing the cache does not cost a malloc()/free() per node.
+ */
+typedef struct __pmpoolchunk_t {
+	struct __pmpoolchunk_t *next;
+	size_t size;
+	size_t used;
+	char data[];
+} pmpoolchunk_t;
+
+typedef struct __pmpool_t {
+	pmpoolchunk_t *chunks; /* the current chunk first */
+	size_t chunksize;
+	unsigned char grow; /* whether the chunks double in size */
+	struct __pmhash_t *strings; /* interned strings, if any */
+	/* counters */
+	unsigned long allocs;
+	unsigned long nchunks;
+	unsigned long bytes;
+} pmpool_t;
+
+#define FREEPOOL(p) do { if(p) { _pacman_pool_free(p); p = NULL; } } while(0)
+
+/* Frees a list of a package allocated from a pool, unless it comes from
+ * the pool as well.
+ */
+#define FREEPOOLLIST(pool, p) do { \
+	if(!_pacman_pool_owns(pool, p)) { \
+		FREELIST(p); \
+	} \
+} while(0)
+/* Same for the files list, whose paths are not owned */
+#define FREEPOOLLISTPTR(pool, p) do { \
+	if(!_pacman_pool_owns(pool, p)) { \
+		FREELISTPTR(p); \
+	} \
+} while(0)
+
+pmpool_t *_pacman_pool_new(size_t chunksize);
+void _pacman_pool_free(pmpool_t *pool);
+void *_pacman_pool_alloc(pmpool_t *pool, size_t size);
+char *_pacman_pool_strdup(pmpool_t *pool, const char *str);
+char *_pacman_pool_intern(pmpool_t *pool, const char *str);
+pmlist_t *_pacman_pool_list_add(pmpool_t *pool, pmlist_t *list, void *data);
+int _pacman_pool_owns(pmpool_t *pool, const void *ptr);
+
+#endif /* _PACMAN_POOL_H */
+
+/* vim: set ts=2 sw=2 noet: */
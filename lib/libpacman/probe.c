@@ -0,0 +1,120 @@
+/*
+ *  probe.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "probe.h"
+
+/* The probes shared by the threads, handed out by chunks */
+typedef struct __pmprober_t {
+	const char *root;
+	pmprobe_t *probes;
+	int count;
+	int next; /* the first probe not handed out yet */
+	pthread_mutex_t lock;
+} pmprober_t;
+
+static void _pacman_probe_file(const char *root, pmprobe_t *probe)
+{
+	char path[PATH_MAX+1];
+	struct stat buf;
+	size_t len;
+
+	snprintf(path, PATH_MAX, "%s%s", root, probe->file);
+	len = strlen(path);
+	/* is this target a file or directory? */
+	if(len > 0 && path[len-1] == '/') {
+		path[len-1] = '\0';
+	}
+	if(lstat(path, &buf)) {
+		probe->type = PM_PROBE_MISSING;
+		return;
+	}
+	/* re-fetch with stat() instead of lstat() */
+	stat(path, &buf);
+	probe->type = S_ISDIR(buf.st_mode) ? PM_PROBE_DIR : PM_PROBE_FILE;
+}
+
+static void *_pacman_probe_thread(void *data)
+{
+	pmprober_t *prober = data;
+
+	for(;;) {
+		int first, last;
+
+		pthread_mutex_lock(&prober->lock);
+		first = prober->next;
+		last = first + PM_PROBE_CHUNK < prober->count ? first + PM_PROBE_CHUNK : prober->count;
+		prober->next = last;
+		pthread_mutex_unlock(&prober->lock);
+		if(first >= last) {
+			break;
+		}
+		for(; first < last; first++) {
+			_pacman_probe_file(prober->root, &prober->probes[first]);
+		}
+	}
+	return(NULL);
+}
+
+/* Sets the type of the count files of probes under root, which are probed
+ * in parallel: their latency is the one of the file system, not of the cpu.
+ * The calling thread probes too, and alone if the threads can not be started.
+ */
+void _pacman_probe(const char *root, pmprobe_t *probes, int count)
+{
+	pthread_t threads[PM_PROBE_THREADS - 1];
+	pmprober_t prober;
+	int i, nthreads;
+
+	prober.root = root;
+	prober.probes = probes;
+	prober.count = count;
+	prober.next = 0;
+	pthread_mutex_init(&prober.lock, NULL);
+
+	nthreads = (count + PM_PROBE_CHUNK - 1) / PM_PROBE_CHUNK;
+	if(nthreads > PM_PROBE_THREADS) {
+		nthreads = PM_PROBE_THREADS;
+	}
+	for(i = 0; i < nthreads - 1; i++) {
+		if(pthread_create(&threads[i], NULL, _pacman_probe_thread, &prober)) {
+			_pacman_log(PM_LOG_DEBUG, _("could not start a probing thread"));
+			break;
+		}
+	}
+	nthreads = i;
+	_pacman_probe_thread(&prober);
+	for(i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&prober.lock);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,43 @@
+/*
+ *  probe.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_PROBE_H
+#define _PACMAN_PROBE_H
+
+/* Types of probed files */
+#define PM_PROBE_MISSING 0
+#define PM_PROBE_DIR     1 /* a directory, or a link to one */
+#define PM_PROBE_FILE    2 /* anything else */
+
+/* Upper bound of the probing threads */
+#define PM_PROBE_THREADS 8
+/* Probes given to a thread at once */
+#define PM_PROBE_CHUNK   64
+
+typedef struct __pmprobe_t {
+	const char *file; /* relative to the root */
+	unsigned char type;
+} pmprobe_t;
+
+void _pacman_probe(const char *root, pmprobe_t *probes, int count);
+
+#endif /* _PACMAN_PROBE_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -26,12 +26,94 @@
 /* pacman-g2 */
 #include "cache.h"
 #include "list.h"
+#include "hash.h"
+#include "package.h"
 #include "db.h"
 #include "provide.h"
 
+/* The provision index of a db maps each provided name to the list of its
+ * providers, kept in package cache order. The key of an entry is the
+ * provides string of its first provider.
+ */
+
+static int _pacman_ptrcmp(const void *p1, const void *p2)
+{
+	return(p1 != p2);
+}
+
+static const char *_pacman_provide_key(pmpkg_t *pkg, const char *name)
+{
+	pmlist_t *i;
+
+	for(i = pkg->provides; i; i = i->next) {
+		if(!strcmp(i->data, name)) {
+			return(i->data);
+		}
+	}
+	return(NULL);
+}
+
+/* append is set when packages are indexed in cache order */
+static void _pacman_db_provides_index(pmdb_t *db, pmpkg_t *pkg, int append)
+{
+	pmlist_t *i;
+
+	for(i = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); i; i = i->next) {
+		pmlist_t *providers = _pacman_hash_get(db->provhash, i->data);
+
+		if(_pacman_list_is_in(pkg, providers)) {
+			/* provided twice by the same package */
+			continue;
+		}
+		if(append) {
+			providers = _pacman_list_add(providers, pkg);
+		} else {
+			providers = _pacman_list_add_sorted(providers, pkg, _pacman_pkg_cmp);
+		}
+		_pacman_hash_add(db->provhash, _pacman_provide_key(providers->data, i->data), providers);
+	}
+}
+
+/* Adds pkg to the provision index of db, if it is built */
+void _pacman_db_provides_add(pmdb_t *db, pmpkg_t *pkg)
+{
+	if(db->provhash) {
+		_pacman_db_provides_index(db, pkg, 0);
+	}
+}
+
+/* Drops pkg from the provision index of db, if it is built */
+void _pacman_db_provides_remove(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmlist_t *i;
+
+	if(db->provhash == NULL) {
+		return;
+	}
+	for(i = pkg->provides; i; i = i->next) {
+		pmlist_t *providers = _pacman_hash_remove(db->provhash, i->data);
+		void *data;
+
+		providers = _pacman_list_remove(providers, pkg, _pacman_ptrcmp, &data);
+		if(providers) {
+			_pacman_hash_add(db->provhash, _pacman_provide_key(providers->data, i->data), providers);
+		}
+	}
+}
+
+static void _pacman_provide_freelist(void *providers)
+{
+	_pacman_list_free(providers, NULL);
+}
+
+void _pacman_db_provides_free(pmdb_t *db)
+{
+	_FREEHASH(db->provhash, _pacman_provide_freelist);
+}
+
 /* return a pmlist_t of packages in "db" that provide "package"
  */
-pmlist_t *_pacman_db_whatprovides(pmdb_t *db, char *package)
+pmlist_t *_pacman_db_whatprovides(pmdb_t *db, const char *package)
 {
 	pmlist_t *pkgs = NULL;
 	pmlist_t *lp;
@@ -40,14 +122,20 @@ pmlist_t *_pacman_db_whatprovides(pmdb_t *db, char *package)
 		return(NULL);
 	}
 
-	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
-		pmpkg_t *info = lp->data;
-
-		if(_pacman_list_is_strin(package, _pacman_pkg_getinfo(info, PM_PKG_PROVIDES))) {
-			pkgs = _pacman_list_add(pkgs, info);
+	if(db->provhash == NULL) {
+		/* built on first use: it needs the DEPENDS info of every package */
+		if((db->provhash = _pacman_hash_new(0)) == NULL) {
+			return(NULL);
+		}
+		for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+			_pacman_db_provides_index(db, lp->data, 1);
 		}
 	}
 
+	for(lp = _pacman_hash_get(db->provhash, package); lp; lp = lp->next) {
+		pkgs = _pacman_list_add(pkgs, lp->data);
+	}
+
 	return(pkgs);
 }
 
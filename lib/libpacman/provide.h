@@ -26,7 +26,10 @@
 #include "list.h"
 #include "db.h"
 
-pmlist_t *_pacman_db_whatprovides(pmdb_t *db, char *package);
+void _pacman_db_provides_add(pmdb_t *db, pmpkg_t *pkg);
+void _pacman_db_provides_remove(pmdb_t *db, pmpkg_t *pkg);
+void _pacman_db_provides_free(pmdb_t *db);
+pmlist_t *_pacman_db_whatprovides(pmdb_t *db, const char *package);
 
 #endif /* _PACMAN_PROVIDE_H */
 
@@ -56,6 +56,8 @@
 #include "provide.h"
 #include "remove.h"
 #include "handle.h"
+#include "path.h"
+#include "bloom.h"
 #include "pacman.h"
 #include "packages_transaction.h"
 
@@ -107,22 +109,8 @@ int _pacman_remove_prepare(pmtrans_t *trans, pmlist_t **data)
 		lp = _pacman_checkdeps(trans, db, trans->type, trans->packages);
 		if(lp != NULL) {
 			if(trans->flags & PM_TRANS_FLAG_CASCADE) {
-				while(lp) {
-					pmlist_t *i;
-					for(i = lp; i; i = i->next) {
-						pmdepmissing_t *miss = (pmdepmissing_t *)i->data;
-						pmpkg_t *info = _pacman_db_scan(db, miss->depend.name, INFRQ_ALL);
-						if(info) {
-							_pacman_log(PM_LOG_FLOW2, _("pulling %s in the targets list"), info->name);
-							trans->packages = _pacman_list_add(trans->packages, info);
-						} else {
-							_pacman_log(PM_LOG_ERROR, _("could not find %s in database -- skipping"),
-								miss->depend.name);
-						}
-					}
-					FREELIST(lp);
-					lp = _pacman_checkdeps(trans, db, trans->type, trans->packages);
-				}
+				FREELIST(lp);
+				trans->packages = _pacman_cascadedeps(db, trans->packages);
 			} else {
 				if(data) {
 					*data = lp;
@@ -140,7 +128,7 @@ int _pacman_remove_prepare(pmtrans_t *trans, pmlist_t **data)
 
 		/* re-order w.r.t. dependencies */
 		_pacman_log(PM_LOG_FLOW1, _("sorting by dependencies"));
-		lp = _pacman_sortbydeps(trans->packages, PM_TRANS_TYPE_REMOVE);
+		lp = _pacman_sortbydeps(trans, trans->packages, PM_TRANS_TYPE_REMOVE);
 		/* free the old alltargs */
 		FREELISTPTR(trans->packages);
 		trans->packages = lp;
@@ -163,14 +151,18 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 	pmpkg_t *info;
 	struct stat buf;
 	pmlist_t *targ, *lp;
+	pmdepcache_t *deps;
 	char line[PATH_MAX+1];
-	int howmany, remain;
+	int howmany, remain, n;
 	pmdb_t *db = trans->handle->db_local;
+	pmbloom_t *skiplist;
 
 	ASSERT(db != NULL, RET_ERR(PM_ERR_DB_NULL, -1));
 	ASSERT(trans != NULL, RET_ERR(PM_ERR_TRANS_NULL, -1));
 
 	howmany = _pacman_list_count(trans->packages);
+	/* most files are not in the skip list, its filter tells them at once */
+	skiplist = _pacman_bloom_paths(trans->skiplist);
 
 	for(targ = trans->packages; targ; targ = targ->next) {
 		int position = 0;
@@ -216,7 +208,8 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 				}
 				if(!nb && trans->type == PM_TRANS_TYPE_UPGRADE) {
 					/* check noupgrade */
-					if(_pacman_list_is_strin(file, handle->noupgrade)) {
+					if(_pacman_bloom_test(handle->noupgradebloom, _pacman_path_hash(file)) &&
+						_pacman_list_is_strin(file, handle->noupgrade)) {
 						nb = 1;
 					}
 				}
@@ -236,14 +229,8 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 					/* check the "skip list" before removing the file.
 					 * see the big comment block in db_find_conflicts() for an
 					 * explanation. */
-					int skipit = 0;
-					pmlist_t *j;
-					for(j = trans->skiplist; j; j = j->next) {
-						if(!strcmp(file, (char*)j->data)) {
-							skipit = 1;
-						}
-					}
-					if(skipit) {
+					if(_pacman_bloom_test(skiplist, _pacman_path_hash(file)) &&
+						_pacman_list_is_in(file, trans->skiplist)) {
 						_pacman_log(PM_LOG_FLOW2, _("skipping removal of %s as it has moved to another package"),
 							file);
 					} else {
@@ -302,24 +289,22 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 
 		/* update dependency packages' REQUIREDBY fields */
 		_pacman_log(PM_LOG_FLOW2, _("updating dependency packages 'requiredby' fields"));
-		for(lp = info->depends; lp; lp = lp->next) {
+		deps = _pacman_parsedeps(info);
+		for(n = 0; deps && n < deps->count; n++) {
 			pmpkg_t *depinfo = NULL;
-			pmdepend_t depend;
+			const pmdepcons_t *depend = &deps->deps[n];
 			char *data;
-			if(_pacman_splitdep((char*)lp->data, &depend)) {
-				continue;
-			}
 			/* if this dependency is in the transaction targets, no need to update
 			 * its requiredby info: it is in the process of being removed (if not
 			 * already done!)
 			 */
-			if(_pacman_pkg_isin(depend.name, trans->packages)) {
+			if(_pacman_pkg_isin(depend->name, trans->packages)) {
 				continue;
 			}
-			depinfo = _pacman_db_get_pkgfromcache(db, depend.name);
+			depinfo = _pacman_db_get_pkgfromcache(db, depend->name);
 			if(depinfo == NULL) {
 				/* look for a provides package */
-				pmlist_t *provides = _pacman_db_whatprovides(db, depend.name);
+				pmlist_t *provides = _pacman_db_whatprovides(db, depend->name);
 				if(provides) {
 					/* TODO: should check _all_ packages listed in provides, not just
 					 *			 the first one.
@@ -329,13 +314,13 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 					FREELISTPTR(provides);
 				}
 				if(depinfo == NULL) {
-					_pacman_log(PM_LOG_ERROR, _("could not find dependency '%s'"), depend.name);
+					_pacman_log(PM_LOG_ERROR, _("could not find dependency '%s'"), depend->name);
 					/* wtf */
 					continue;
 				}
 			}
 			/* splice out this entry from requiredby */
-			depinfo->requiredby = _pacman_list_remove(_pacman_pkg_getinfo(depinfo, PM_PKG_REQUIREDBY), info->name, str_cmp, (void **)&data);
+			depinfo->requiredby = _pacman_list_remove(_pacman_pkg_editlist(depinfo, _pacman_pkg_getinfo(depinfo, PM_PKG_REQUIREDBY)), info->name, str_cmp, (void **)&data);
 			FREE(data);
 			_pacman_log(PM_LOG_DEBUG, _("updating 'requiredby' field for package '%s'"), depinfo->name);
 			if(_pacman_db_write(db, depinfo, INFRQ_DEPENDS)) {
@@ -354,6 +339,7 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 		_pacman_ldconfig(handle->root);
 	}
 
+	FREE(skiplist);
 	return(0);
 }
 
@@ -0,0 +1,177 @@
+/*
+ *  requiredby.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "list.h"
+#include "hash.h"
+#include "package.h"
+#include "db.h"
+#include "cache.h"
+#include "deps.h"
+#include "requiredby.h"
+
+/* The reverse dependency index of a db maps each depended upon name to the
+ * packages of pkgcache depending on it, in no particular order.  An entry
+ * owns the copy of the name it is keyed by.
+ */
+typedef struct __pmdependers_t {
+	pmlist_t *pkgs;
+	char name[];
+} pmdependers_t;
+
+static int _pacman_ptrcmp(const void *p1, const void *p2)
+{
+	return(p1 != p2);
+}
+
+static void _pacman_dependers_free(void *data)
+{
+	pmdependers_t *dependers = data;
+
+	FREELISTPTR(dependers->pkgs);
+	free(dependers);
+}
+
+static void _pacman_db_requiredby_index(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmdepcache_t *deps = _pacman_parsedeps(pkg);
+	int n;
+
+	for(n = 0; deps && n < deps->count; n++) {
+		const char *name = deps->deps[n].name;
+		pmdependers_t *dependers = _pacman_hash_get(db->revhash, name);
+
+		if(dependers == NULL) {
+			if((dependers = _pacman_malloc(sizeof(pmdependers_t) + strlen(name) + 1)) == NULL) {
+				continue;
+			}
+			dependers->pkgs = NULL;
+			strcpy(dependers->name, name);
+			_pacman_hash_add(db->revhash, dependers->name, dependers);
+		} else if(dependers->pkgs->last->data == pkg) {
+			/* depended upon twice by the same package */
+			continue;
+		}
+		dependers->pkgs = _pacman_list_add(dependers->pkgs, pkg);
+	}
+}
+
+/* Adds pkg to the reverse dependency index of db, if it is built */
+void _pacman_db_requiredby_add(pmdb_t *db, pmpkg_t *pkg)
+{
+	if(db->revhash) {
+		_pacman_db_requiredby_index(db, pkg);
+	}
+}
+
+/* Drops pkg from the reverse dependency index of db, if it is built.
+ * The depends of pkg must be the ones it was indexed with.
+ */
+void _pacman_db_requiredby_remove(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmdepcache_t *deps;
+	int n;
+
+	if(db->revhash == NULL || (deps = _pacman_parsedeps(pkg)) == NULL) {
+		return;
+	}
+	for(n = 0; n < deps->count; n++) {
+		pmdependers_t *dependers = _pacman_hash_get(db->revhash, deps->deps[n].name);
+		void *data;
+
+		if(dependers == NULL) {
+			continue;
+		}
+		dependers->pkgs = _pacman_list_remove(dependers->pkgs, pkg, _pacman_ptrcmp, &data);
+		if(dependers->pkgs == NULL) {
+			_pacman_hash_remove(db->revhash, dependers->name);
+			free(dependers);
+		}
+	}
+}
+
+void _pacman_db_requiredby_free(pmdb_t *db)
+{
+	_FREEHASH(db->revhash, _pacman_dependers_free);
+}
+
+/* Returns the requiredby field of pkg if it was installed in db: the names
+ * of the packages of pkgcache having a dependency on the name or on one of
+ * the provides of pkg, once per such dependency, in pkgcache order.
+ */
+pmlist_t *_pacman_db_requiredby(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmlist_t *candidates = NULL, *requiredby = NULL;
+	pmdependers_t *dependers;
+	pmlist_t *i, *j;
+
+	if(db->revhash == NULL) {
+		/* built on first use: it needs the DEPENDS info of every package */
+		if((db->revhash = _pacman_hash_new(0)) == NULL) {
+			return(NULL);
+		}
+		for(i = _pacman_db_get_pkgcache(db); i; i = i->next) {
+			_pacman_db_requiredby_index(db, i->data);
+		}
+	}
+
+	if((dependers = _pacman_hash_get(db->revhash, pkg->name)) != NULL) {
+		for(i = dependers->pkgs; i; i = i->next) {
+			candidates = _pacman_list_add(candidates, i->data);
+		}
+	}
+	for(j = pkg->provides; j; j = j->next) {
+		if((dependers = _pacman_hash_get(db->revhash, j->data)) == NULL) {
+			continue;
+		}
+		for(i = dependers->pkgs; i; i = i->next) {
+			if(!_pacman_list_is_in(i->data, candidates)) {
+				candidates = _pacman_list_add(candidates, i->data);
+			}
+		}
+	}
+	candidates = _pacman_list_sort(candidates, _pacman_pkg_cmp);
+
+	for(i = candidates; i; i = i->next) {
+		pmpkg_t *depender = i->data;
+		pmdepcache_t *deps = _pacman_parsedeps(depender);
+		int n;
+
+		for(n = 0; deps && n < deps->count; n++) {
+			const char *name = deps->deps[n].name;
+			if(!strcmp(name, pkg->name) || _pacman_list_is_strin(name, pkg->provides)) {
+				_pacman_log(PM_LOG_DEBUG, _("adding '%s' in requiredby field for '%s'"), depender->name, pkg->name);
+				requiredby = _pacman_list_add(requiredby, strdup(depender->name));
+			}
+		}
+	}
+	FREELISTPTR(candidates);
+
+	return(requiredby);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,34 @@
+/*
+ *  requiredby.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_REQUIREDBY_H
+#define _PACMAN_REQUIREDBY_H
+
+#include "list.h"
+#include "db.h"
+
+void _pacman_db_requiredby_add(pmdb_t *db, pmpkg_t *pkg);
+void _pacman_db_requiredby_remove(pmdb_t *db, pmpkg_t *pkg);
+void _pacman_db_requiredby_free(pmdb_t *db);
+pmlist_t *_pacman_db_requiredby(pmdb_t *db, pmpkg_t *pkg);
+
+#endif /* _PACMAN_REQUIREDBY_H */
+
+/* vim: set ts=2 sw=2 noet: */
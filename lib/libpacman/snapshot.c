@@ -0,0 +1,812 @@
+/*
+ *  snapshot.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "list.h"
+#include "package.h"
+#include "db.h"
+#include "handle.h"
+#include "error.h"
+#include "pool.h"
+#include "path.h"
+#include "snapshot.h"
+
+/* A snapshot is a single file holding every record of a database, so that
+ * loading the package cache costs one mmap() instead of opening and parsing
+ * the desc/depends files of each entry, or inflating the whole archive of a
+ * sync db.
+ *
+ * Layout (host byte order, the snapshot is never shared between hosts):
+ *   header
+ *   for each package, sorted by name:
+ *     unsigned int reclen   size of the record body
+ *     unsigned int filesoff absolute offset of the file list fields
+ *     fields ... SNAP_END   desc, depends and scriptlet informations
+ *     fields ... SNAP_END   file list and backup entries (local db only)
+ *   name index: the absolute offset of each record, as an unsigned int
+ * A field is a tag byte, an unsigned int length and a NUL terminated string.
+ * The first field of a record is always its name, so that the index can be
+ * binary searched without decoding whole records.
+ * The records of the local db hold the stamp of the files of their entry
+ * (see _pacman_db_stamp()): a record whose entry was edited in place since
+ * is not used, the package is read from the database instead.
+ */
+
+#define SNAPSHOT_MAGIC   "PMSNAP"
+#define SNAPSHOT_VERSION 4
+
+enum {
+	SNAP_END = 0,
+	SNAP_NAME,
+	SNAP_VERSION,
+	SNAP_DESC,
+	SNAP_URL,
+	SNAP_BUILDDATE,
+	SNAP_BUILDTYPE,
+	SNAP_INSTALLDATE,
+	SNAP_PACKAGER,
+	SNAP_MD5SUM,
+	SNAP_SHA1SUM,
+	SNAP_ARCH,
+	SNAP_SIZE,
+	SNAP_USIZE,
+	SNAP_REASON,
+	SNAP_SCRIPTLET,
+	SNAP_FORCE,
+	SNAP_STICK,
+	SNAP_LICENSE,
+	SNAP_GROUPS,
+	SNAP_REPLACES,
+	SNAP_DEPENDS,
+	SNAP_REQUIREDBY,
+	SNAP_CONFLICTS,
+	SNAP_PROVIDES,
+	SNAP_FILES,
+	SNAP_BACKUP,
+	SNAP_STAMP
+};
+
+/* What the snapshot was built from: if any of these changed, the
+ * snapshot is out of date.
+ * For the local db this is the stat of its directory, which changes when an
+ * entry is added or removed. The entries edited in place are caught by the
+ * stamps of the records.
+ */
+typedef struct __pmsnapkey_t {
+	unsigned long long dev;
+	unsigned long long ino;
+	unsigned long long size;
+	unsigned long long mtime;
+	unsigned long long mtimensec; /* 0 if the file system has no better than seconds */
+	char lastupdate[16];
+} pmsnapkey_t;
+
+typedef struct __pmsnaphdr_t {
+	char magic[8];
+	unsigned int version;
+	unsigned int count;
+	unsigned int index; /* offset of the name index */
+	pmsnapkey_t key;
+} pmsnaphdr_t;
+
+typedef struct __pmsnapbuf_t {
+	char *data;
+	size_t len;
+	size_t size;
+} pmsnapbuf_t;
+
+/* Informations stored in the main part of a record */
+static unsigned int _pacman_db_snapshot_infolevel(pmdb_t *db)
+{
+	if(db == handle->db_local) {
+		return(INFRQ_DESC | INFRQ_DEPENDS | INFRQ_SCRIPLET);
+	}
+	return(INFRQ_DESC | INFRQ_DEPENDS);
+}
+
+static int _pacman_db_snapshot_key(pmdb_t *db, pmsnapkey_t *key)
+{
+	char path[PATH_MAX];
+	struct stat buf;
+
+	memset(key, 0, sizeof(pmsnapkey_t));
+	if(db == handle->db_local) {
+		/* adding or removing an entry updates the mtime of the db directory */
+		STRNCPY(path, db->path, PATH_MAX);
+	} else {
+		/* a sync db is replaced as a whole by pacman_db_update() */
+		snprintf(path, PATH_MAX, "%s" PM_EXT_DB, db->path);
+		if(_pacman_db_getlastupdate(db, key->lastupdate) == -1) {
+			key->lastupdate[0] = '\0';
+		}
+	}
+	if(stat(path, &buf) != 0) {
+		return(-1);
+	}
+	key->dev = buf.st_dev;
+	key->ino = buf.st_ino;
+	key->size = buf.st_size;
+	key->mtime = buf.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	/* an entry added and another removed within the same second */
+	key->mtimensec = buf.st_mtim.tv_nsec;
+#endif
+
+	return(0);
+}
+
+static pmsnapshot_t *_pacman_db_snapshot_map(pmdb_t *db)
+{
+	char path[PATH_MAX];
+	struct stat buf;
+	pmsnapshot_t *snap;
+	pmsnaphdr_t *hdr;
+	pmsnapkey_t key;
+	void *base;
+	int fd;
+
+	snprintf(path, PATH_MAX, "%s" SNAPSHOT_EXT, db->path);
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(NULL);
+	}
+	if(fstat(fd, &buf) != 0 || (size_t)buf.st_size < sizeof(pmsnaphdr_t)) {
+		close(fd);
+		return(NULL);
+	}
+	base = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) {
+		return(NULL);
+	}
+
+	hdr = base;
+	if(strcmp(hdr->magic, SNAPSHOT_MAGIC) || hdr->version != SNAPSHOT_VERSION ||
+		_pacman_db_snapshot_key(db, &key) == -1 || memcmp(&key, &hdr->key, sizeof(pmsnapkey_t))) {
+		_pacman_log(PM_LOG_DEBUG, _("snapshot for '%s' is out of date"), db->treename);
+		munmap(base, buf.st_size);
+		return(NULL);
+	}
+
+	if((snap = _pacman_malloc(sizeof(pmsnapshot_t))) == NULL) {
+		munmap(base, buf.st_size);
+		return(NULL);
+	}
+	snap->base = base;
+	snap->size = buf.st_size;
+
+	return(snap);
+}
+
+/* Reads the field at *ptr and advances *ptr past it.
+ * Returns -1 if the field does not fit before end.
+ */
+static int _pacman_db_snapshot_next(const char **ptr, const char *end, unsigned char *tag, const char **str)
+{
+	const char *p = *ptr;
+	unsigned int len;
+
+	if(p >= end) {
+		return(-1);
+	}
+	*tag = *p++;
+	if(*tag != SNAP_END) {
+		if((size_t)(end - p) < sizeof(len)) {
+			return(-1);
+		}
+		memcpy(&len, p, sizeof(len));
+		p += sizeof(len);
+		if((size_t)(end - p) <= len || p[len] != '\0') {
+			return(-1);
+		}
+		*str = p;
+		p += len + 1;
+	}
+	*ptr = p;
+
+	return(0);
+}
+
+/* Appends a copy of str to list, from the pool of info if it has one */
+static pmlist_t *_pacman_db_snapshot_add(pmpkg_t *info, pmlist_t *list, const char *str)
+{
+	if(info->pool) {
+		return(_pacman_pool_list_add(info->pool, list, _pacman_pool_strdup(info->pool, str)));
+	}
+	return(_pacman_list_add(list, strdup(str)));
+}
+
+/* Same as _pacman_db_snapshot_add() for a path of the files list */
+static pmlist_t *_pacman_db_snapshot_addpath(pmpkg_t *info, pmlist_t *list, const char *str)
+{
+	char *path = (char *)_pacman_path_intern(str);
+
+	if(info->pool) {
+		return(_pacman_pool_list_add(info->pool, list, path));
+	}
+	return(_pacman_list_add(list, path));
+}
+
+static int _pacman_db_snapshot_decode(pmpkg_t *info, const char **ptr, const char *end, const char **stamp)
+{
+	unsigned char tag;
+	const char *str = NULL;
+	pmpkgcold_t *cold;
+
+	while(_pacman_db_snapshot_next(ptr, end, &tag, &str) == 0) {
+		switch(tag) {
+			case SNAP_END:
+				return(0);
+			case SNAP_NAME: _pacman_pkg_set(info, PM_PKG_NAME, str); break;
+			case SNAP_VERSION: _pacman_pkg_set(info, PM_PKG_VERSION, str); break;
+			case SNAP_DESC:
+				if((cold = _pacman_pkg_cold(info)) == NULL) {
+					return(-1);
+				}
+				cold->desc_localized = _pacman_db_snapshot_add(info, cold->desc_localized, str);
+			break;
+			case SNAP_URL: _pacman_pkg_set(info, PM_PKG_URL, str); break;
+			case SNAP_BUILDDATE: _pacman_pkg_set(info, PM_PKG_BUILDDATE, str); break;
+			case SNAP_BUILDTYPE: _pacman_pkg_set(info, PM_PKG_BUILDTYPE, str); break;
+			case SNAP_INSTALLDATE: _pacman_pkg_set(info, PM_PKG_INSTALLDATE, str); break;
+			case SNAP_PACKAGER: _pacman_pkg_set(info, PM_PKG_PACKAGER, str); break;
+			case SNAP_MD5SUM: _pacman_pkg_set(info, PM_PKG_MD5SUM, str); break;
+			case SNAP_SHA1SUM: _pacman_pkg_set(info, PM_PKG_SHA1SUM, str); break;
+			case SNAP_ARCH: _pacman_pkg_set(info, PM_PKG_ARCH, str); break;
+			case SNAP_SIZE: info->size = atol(str); break;
+			case SNAP_USIZE: info->usize = atol(str); break;
+			case SNAP_REASON: info->reason = atol(str); break;
+			case SNAP_SCRIPTLET: info->scriptlet = 1; break;
+			case SNAP_FORCE: info->force = 1; break;
+			case SNAP_STICK: info->stick = 1; break;
+			case SNAP_LICENSE:
+				if((cold = _pacman_pkg_cold(info)) == NULL) {
+					return(-1);
+				}
+				cold->license = _pacman_db_snapshot_add(info, cold->license, str);
+			break;
+			case SNAP_GROUPS: info->groups = _pacman_db_snapshot_add(info, info->groups, str); break;
+			case SNAP_REPLACES: info->replaces = _pacman_db_snapshot_add(info, info->replaces, str); break;
+			case SNAP_DEPENDS: info->depends = _pacman_db_snapshot_add(info, info->depends, str); break;
+			case SNAP_REQUIREDBY: info->requiredby = _pacman_db_snapshot_add(info, info->requiredby, str); break;
+			case SNAP_CONFLICTS: info->conflicts = _pacman_db_snapshot_add(info, info->conflicts, str); break;
+			case SNAP_PROVIDES: info->provides = _pacman_db_snapshot_add(info, info->provides, str); break;
+			case SNAP_FILES: info->files = _pacman_db_snapshot_addpath(info, info->files, str); break;
+			case SNAP_BACKUP: info->backup = _pacman_db_snapshot_add(info, info->backup, str); break;
+			case SNAP_STAMP: *stamp = str; break;
+			default:
+				return(-1);
+		}
+	}
+
+	return(-1);
+}
+
+/* Decodes the record at offset and stores the offset of the next one in
+ * next. The record is allocated from pool if not NULL.
+ * If the entry of a local db record was edited since the snapshot was
+ * written, only its name and version are kept, and the rest is read from the
+ * database when needed.
+ * Returns NULL if the record is corrupted.
+ */
+static pmpkg_t *_pacman_db_snapshot_record(pmdb_t *db, pmsnapshot_t *snap, pmpool_t *pool, size_t offset, size_t *next)
+{
+	unsigned int reclen, filesoff;
+	const char *ptr, *stamp = NULL;
+	char now[32];
+	pmpkg_t *info;
+
+	if(offset > snap->size || snap->size - offset < 2 * sizeof(unsigned int)) {
+		return(NULL);
+	}
+	ptr = snap->base + offset;
+	memcpy(&reclen, ptr, sizeof(reclen));
+	memcpy(&filesoff, ptr + sizeof(reclen), sizeof(filesoff));
+	ptr += 2 * sizeof(unsigned int);
+	offset += 2 * sizeof(unsigned int);
+	if(snap->size - offset < reclen) {
+		return(NULL);
+	}
+
+	info = pool ? _pacman_pkg_new_pooled(pool, NULL, NULL) : _pacman_pkg_new(NULL, NULL);
+	if(info == NULL) {
+		return(NULL);
+	}
+	if(_pacman_db_snapshot_decode(info, &ptr, snap->base + offset + reclen, &stamp) == -1 ||
+		info->name[0] == '\0' || info->version[0] == '\0') {
+		FREEPKG(info);
+		return(NULL);
+	}
+	*next = offset + reclen;
+	if(db == handle->db_local) {
+		snprintf(now, sizeof(now), "%016llx", _pacman_db_stamp(db, info->name, info->version, INFRQ_ALL));
+		if(stamp == NULL || strcmp(stamp, now)) {
+			pmpkg_t *pkg = pool ? _pacman_pkg_new_pooled(pool, info->name, info->version) : _pacman_pkg_new(info->name, info->version);
+
+			_pacman_log(PM_LOG_DEBUG, _("snapshot entry '%s' is out of date"), info->name);
+			FREEPKG(info);
+			if(pkg != NULL) {
+				pkg->origin = PKG_FROM_CACHE;
+				pkg->data = db;
+			}
+			return(pkg);
+		}
+	}
+	if(PKG_COLD(info)->desc_localized) {
+		_pacman_pkg_localize_desc(info);
+	}
+	info->origin = PKG_FROM_CACHE;
+	info->data = db;
+	info->infolevel = _pacman_db_snapshot_infolevel(db);
+	info->snapoff = filesoff;
+
+	return(info);
+}
+
+/* Returns the name of the record at offset, or NULL if it is corrupted */
+static const char *_pacman_db_snapshot_name(pmsnapshot_t *snap, size_t offset)
+{
+	const char *ptr, *str = NULL;
+	unsigned char tag;
+
+	if(offset > snap->size || snap->size - offset < 2 * sizeof(unsigned int)) {
+		return(NULL);
+	}
+	ptr = snap->base + offset + 2 * sizeof(unsigned int);
+	if(_pacman_db_snapshot_next(&ptr, snap->base + snap->size, &tag, &str) == -1 || tag != SNAP_NAME) {
+		return(NULL);
+	}
+
+	return(str);
+}
+
+/* Loads the package cache of db from its snapshot.
+ * Returns -1 if there is no usable snapshot, the caller then has to fall
+ * back to the database itself.
+ */
+int _pacman_db_snapshot_load(pmdb_t *db)
+{
+	pmsnapshot_t *snap;
+	pmsnaphdr_t *hdr;
+	size_t offset;
+	unsigned int i, stale = 0;
+
+	if(db == NULL) {
+		return(-1);
+	}
+
+	_pacman_db_snapshot_close(db);
+	if((snap = _pacman_db_snapshot_map(db)) == NULL) {
+		return(-1);
+	}
+	hdr = (pmsnaphdr_t *)snap->base;
+	offset = sizeof(pmsnaphdr_t);
+	db->pkgcache = _pacman_vector_new(hdr->count);
+	db->pool = _pacman_pool_new(0);
+	if(db->pkgcache == NULL || db->pool == NULL) {
+		_FREEVECTOR(db->pkgcache, NULL);
+		FREEPOOL(db->pool);
+		munmap(snap->base, snap->size);
+		free(snap);
+		return(-1);
+	}
+
+	for(i = 0; i < hdr->count; i++) {
+		pmpkg_t *info = _pacman_db_snapshot_record(db, snap, db->pool, offset, &offset);
+
+		if(info == NULL) {
+			_pacman_log(PM_LOG_WARNING, _("snapshot for '%s' is corrupted, ignoring it"), db->treename);
+			_FREEVECTOR(db->pkgcache, _pacman_pkg_free);
+			FREEPOOL(db->pool);
+			munmap(snap->base, snap->size);
+			free(snap);
+			return(-1);
+		}
+		if(info->infolevel == 0) {
+			stale++;
+		}
+		/* records are stored sorted, no need for _pacman_vector_sort() */
+		_pacman_vector_add(db->pkgcache, info);
+	}
+	db->snapshot = snap;
+	_pacman_log(PM_LOG_DEBUG, _("loaded %d entries from the snapshot of '%s' (%lu allocations in %lu blocks)"),
+		hdr->count, db->treename, db->pool->allocs, db->pool->nchunks);
+	if(stale && handle->access == PM_ACCESS_RW) {
+		/* the edited entries are read once, for the next time */
+		_pacman_db_snapshot_write(db);
+	}
+
+	return(0);
+}
+
+/* Looks target up in the name index of the snapshot of db, without loading
+ * the package cache.
+ * Returns -1 if db has no usable snapshot. Otherwise stores a new entry,
+ * not part of the package cache, in pkg, or NULL if there is no such package.
+ */
+int _pacman_db_snapshot_find(pmdb_t *db, const char *target, pmpkg_t **pkg)
+{
+	pmsnapshot_t *snap;
+	pmsnaphdr_t *hdr;
+	unsigned int lo, hi;
+
+	if(db == NULL || target == NULL || pkg == NULL) {
+		return(-1);
+	}
+
+	if(db->snapshot == NULL) {
+		db->snapshot = _pacman_db_snapshot_map(db);
+	}
+	if((snap = db->snapshot) == NULL) {
+		return(-1);
+	}
+	hdr = (pmsnaphdr_t *)snap->base;
+	if(hdr->index < sizeof(pmsnaphdr_t) || hdr->index > snap->size ||
+		(snap->size - hdr->index) / sizeof(unsigned int) < hdr->count) {
+		return(-1);
+	}
+
+	*pkg = NULL;
+	lo = 0;
+	hi = hdr->count;
+	while(lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		unsigned int offset;
+		const char *name;
+		size_t next;
+		int cmp;
+
+		memcpy(&offset, snap->base + hdr->index + mid * sizeof(offset), sizeof(offset));
+		if((name = _pacman_db_snapshot_name(snap, offset)) == NULL) {
+			return(-1);
+		}
+		if((cmp = strcmp(target, name)) == 0) {
+			if((*pkg = _pacman_db_snapshot_record(db, snap, NULL, offset, &next)) == NULL) {
+				return(-1);
+			}
+			(*pkg)->origin = 0;
+			(*pkg)->data = NULL;
+			return(0);
+		} else if(cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	return(0);
+}
+
+/* Reads the file list of info from the snapshot.
+ * Returns -1 if it has to be read from the database itself.
+ */
+int _pacman_db_snapshot_readfiles(pmdb_t *db, pmpkg_t *info)
+{
+	pmsnapshot_t *snap;
+	const char *ptr;
+	unsigned char tag;
+	const char *str = NULL;
+
+	if(db == NULL || info == NULL || (snap = db->snapshot) == NULL ||
+		info->snapoff == 0 || info->snapoff >= snap->size) {
+		return(-1);
+	}
+
+	ptr = snap->base + info->snapoff;
+	while(_pacman_db_snapshot_next(&ptr, snap->base + snap->size, &tag, &str) == 0) {
+		switch(tag) {
+			case SNAP_END:
+				return(0);
+			case SNAP_FILES: info->files = _pacman_db_snapshot_addpath(info, info->files, str); break;
+			case SNAP_BACKUP: info->backup = _pacman_db_snapshot_add(info, info->backup, str); break;
+			default:
+				break;
+		}
+	}
+	if(info->pool) {
+		/* left in the pool */
+		info->files = info->backup = NULL;
+	} else {
+		FREELISTPTR(info->files);
+		FREELIST(info->backup);
+	}
+
+	return(-1);
+}
+
+static int _pacman_db_snapshot_put(pmsnapbuf_t *buf, unsigned char tag, const char *str)
+{
+	unsigned int len = str ? strlen(str) : 0;
+	size_t need = 1 + sizeof(len) + len + 1;
+
+	if(buf->len + need > buf->size) {
+		size_t size = buf->size ? buf->size : 4096;
+		char *data;
+
+		while(buf->len + need > size) {
+			size *= 2;
+		}
+		if((data = realloc(buf->data, size)) == NULL) {
+			return(-1);
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+	buf->data[buf->len++] = tag;
+	if(tag != SNAP_END) {
+		memcpy(buf->data + buf->len, &len, sizeof(len));
+		buf->len += sizeof(len);
+		memcpy(buf->data + buf->len, str, len);
+		buf->len += len;
+		buf->data[buf->len++] = '\0';
+	}
+
+	return(0);
+}
+
+static int _pacman_db_snapshot_putstr(pmsnapbuf_t *buf, unsigned char tag, const char *str)
+{
+	if(str[0] == '\0') {
+		return(0);
+	}
+	return(_pacman_db_snapshot_put(buf, tag, str));
+}
+
+static int _pacman_db_snapshot_putnum(pmsnapbuf_t *buf, unsigned char tag, unsigned long num)
+{
+	char str[32];
+
+	if(num == 0) {
+		return(0);
+	}
+	snprintf(str, sizeof(str), "%lu", num);
+	return(_pacman_db_snapshot_put(buf, tag, str));
+}
+
+static int _pacman_db_snapshot_putlist(pmsnapbuf_t *buf, unsigned char tag, pmlist_t *list)
+{
+	pmlist_t *lp;
+
+	for(lp = list; lp; lp = lp->next) {
+		if(_pacman_db_snapshot_put(buf, tag, lp->data) == -1) {
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+static int _pacman_db_snapshot_encode(pmsnapbuf_t *buf, pmpkg_t *info, const char *stamp)
+{
+	const pmpkgcold_t *cold = PKG_COLD(info);
+	int ret = 0;
+
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_NAME, info->name);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_VERSION, info->version);
+	if(stamp) {
+		ret |= _pacman_db_snapshot_putstr(buf, SNAP_STAMP, stamp);
+	}
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_DESC, cold->desc_localized);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_URL, cold->url);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_BUILDDATE, cold->builddate);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_BUILDTYPE, cold->buildtype);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_INSTALLDATE, cold->installdate);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_PACKAGER, cold->packager);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_MD5SUM, cold->md5sum);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_SHA1SUM, cold->sha1sum);
+	ret |= _pacman_db_snapshot_putstr(buf, SNAP_ARCH, info->arch);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_SIZE, info->size);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_USIZE, info->usize);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_REASON, info->reason);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_SCRIPTLET, info->scriptlet);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_FORCE, info->force);
+	ret |= _pacman_db_snapshot_putnum(buf, SNAP_STICK, info->stick);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_LICENSE, cold->license);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_GROUPS, info->groups);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_REPLACES, info->replaces);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_DEPENDS, info->depends);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_REQUIREDBY, info->requiredby);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_CONFLICTS, info->conflicts);
+	ret |= _pacman_db_snapshot_putlist(buf, SNAP_PROVIDES, info->provides);
+	ret |= _pacman_db_snapshot_put(buf, SNAP_END, NULL);
+
+	return(ret ? -1 : 0);
+}
+
+/* Writes a snapshot of the package cache of db, reading the missing
+ * informations from the database on the way.
+ * The file lists are not kept in memory, they are only read back from the
+ * snapshot when needed.
+ */
+int _pacman_db_snapshot_write(pmdb_t *db)
+{
+	char path[PATH_MAX], tmppath[PATH_MAX + sizeof(".XXXXXX")];
+	pmsnaphdr_t hdr;
+	pmsnapbuf_t buf;
+	unsigned long offset;
+	unsigned int *index;
+	pmlist_t *lp;
+	FILE *fp;
+	int fd;
+	unsigned int i, infolevel;
+
+	if(db == NULL) {
+		return(-1);
+	}
+	infolevel = _pacman_db_snapshot_infolevel(db);
+
+	memset(&hdr, 0, sizeof(hdr));
+	strcpy(hdr.magic, SNAPSHOT_MAGIC);
+	hdr.version = SNAPSHOT_VERSION;
+	hdr.count = _pacman_vector_count(db->pkgcache);
+	/* compute the key first, so that changes made while we are writing
+	 * make the snapshot out of date */
+	if(_pacman_db_snapshot_key(db, &hdr.key) == -1) {
+		return(-1);
+	}
+
+	snprintf(path, PATH_MAX, "%s" SNAPSHOT_EXT, db->path);
+	snprintf(tmppath, sizeof(tmppath), "%s.XXXXXX", path);
+	if((fd = mkstemp(tmppath)) == -1) {
+		/* most likely a read-only access to the database */
+		return(-1);
+	}
+	if((fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlink(tmppath);
+		return(-1);
+	}
+	fchmod(fd, 0644);
+	if((index = _pacman_malloc((hdr.count + 1) * sizeof(unsigned int))) == NULL) {
+		fclose(fp);
+		unlink(tmppath);
+		return(-1);
+	}
+
+	_pacman_log(PM_LOG_DEBUG, _("writing snapshot for '%s'"), db->treename);
+
+	memset(&buf, 0, sizeof(buf));
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	offset = sizeof(hdr);
+	for(lp = _pacman_vector_list(db->pkgcache), i = 0; lp; lp = lp->next, i++) {
+		pmpkg_t *info = lp->data;
+		unsigned int reclen, filesoff;
+		char stamp[32];
+		int files = 0;
+
+		if(db == handle->db_local) {
+			/* before reading the entry, like the key */
+			snprintf(stamp, sizeof(stamp), "%016llx", _pacman_db_stamp(db, info->name, info->version, INFRQ_ALL));
+		}
+		if((info->infolevel & infolevel) != infolevel) {
+			if(_pacman_db_read(db, infolevel & ~info->infolevel, info) == -1) {
+				goto error;
+			}
+		}
+		buf.len = 0;
+		if(_pacman_db_snapshot_encode(&buf, info, (db == handle->db_local) ? stamp : NULL) == -1) {
+			goto error;
+		}
+		filesoff = offset + 2 * sizeof(unsigned int) + buf.len;
+		if(db == handle->db_local && !(info->infolevel & INFRQ_FILES)) {
+			if(_pacman_db_read(db, INFRQ_FILES, info) == -1) {
+				goto error;
+			}
+			files = 1;
+		}
+		if(_pacman_db_snapshot_putlist(&buf, SNAP_FILES, info->files) == -1 ||
+			_pacman_db_snapshot_putlist(&buf, SNAP_BACKUP, info->backup) == -1 ||
+			_pacman_db_snapshot_put(&buf, SNAP_END, NULL) == -1) {
+			goto error;
+		}
+		if(files) {
+			if(info->pool) {
+				/* the lists come from the previous snapshot or from the database */
+				FREEPOOLLISTPTR(info->pool, info->files);
+				FREEPOOLLIST(info->pool, info->backup);
+				info->files = info->backup = NULL;
+			} else {
+				FREELISTPTR(info->files);
+				FREELIST(info->backup);
+			}
+			info->infolevel &= ~INFRQ_FILES;
+		}
+		reclen = buf.len;
+		index[i] = offset;
+		fwrite(&reclen, sizeof(reclen), 1, fp);
+		fwrite(&filesoff, sizeof(filesoff), 1, fp);
+		fwrite(buf.data, buf.len, 1, fp);
+		offset += 2 * sizeof(unsigned int) + reclen;
+		info->snapoff = filesoff;
+	}
+	FREE(buf.data);
+
+	/* the cache is sorted by name, so is the index */
+	hdr.index = offset;
+	fwrite(index, sizeof(unsigned int), hdr.count, fp);
+	FREE(index);
+	rewind(fp);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	if(ferror(fp) | fclose(fp)) {
+		_pacman_log(PM_LOG_WARNING, _("could not write snapshot %s"), path);
+		unlink(tmppath);
+		return(-1);
+	}
+	if(rename(tmppath, path) != 0) {
+		unlink(tmppath);
+		return(-1);
+	}
+
+	/* the cached entries now refer to the new snapshot for their file lists */
+	_pacman_db_snapshot_close(db);
+	db->snapshot = _pacman_db_snapshot_map(db);
+
+	return(0);
+
+error:
+	FREE(buf.data);
+	FREE(index);
+	fclose(fp);
+	unlink(tmppath);
+	return(-1);
+}
+
+void _pacman_db_snapshot_close(pmdb_t *db)
+{
+	if(db == NULL || db->snapshot == NULL) {
+		return;
+	}
+
+	munmap(db->snapshot->base, db->snapshot->size);
+	FREE(db->snapshot);
+}
+
+/* Drops the snapshot of db, it will be rebuilt from the database the next
+ * time the package cache is loaded.
+ */
+void _pacman_db_snapshot_invalidate(pmdb_t *db)
+{
+	char path[PATH_MAX];
+
+	if(db == NULL) {
+		return;
+	}
+
+	_pacman_db_snapshot_close(db);
+	snprintf(path, PATH_MAX, "%s" SNAPSHOT_EXT, db->path);
+	unlink(path);
+}
+
+/* vim: set ts=2 sw=2 noet: */
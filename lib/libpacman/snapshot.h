@@ -0,0 +1,43 @@
+/*
+ *  snapshot.h
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_SNAPSHOT_H
+#define _PACMAN_SNAPSHOT_H
+
+#include "db.h"
+
+#define SNAPSHOT_EXT ".cache"
+
+/* A read-only mapping of a database snapshot file */
+typedef struct __pmsnapshot_t {
+	char *base;
+	size_t size;
+} pmsnapshot_t;
+
+int _pacman_db_snapshot_load(pmdb_t *db);
+int _pacman_db_snapshot_find(pmdb_t *db, const char *target, pmpkg_t **pkg);
+int _pacman_db_snapshot_write(pmdb_t *db);
+int _pacman_db_snapshot_readfiles(pmdb_t *db, pmpkg_t *info);
+void _pacman_db_snapshot_close(pmdb_t *db);
+void _pacman_db_snapshot_invalidate(pmdb_t *db);
+
+#endif /* _PACMAN_SNAPSHOT_H */
+
+/* vim: set ts=2 sw=2 noet: */
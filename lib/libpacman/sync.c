@@ -43,6 +43,7 @@
 #include "deps.h"
 #include "conflict.h"
 #include "provide.h"
+#include "requiredby.h"
 #include "trans.h"
 #include "util.h"
 #include "sync.h"
@@ -138,8 +139,8 @@ int _pacman_sync_addtarget(pmtrans_t *trans, const char *name)
 					if(p == NULL) {
 						RET_ERR(PM_ERR_PKG_NOT_FOUND, -1);
 					}
-					_pacman_log(PM_LOG_DEBUG, _("found '%s' as a provision for '%s'"), p->data, targ);
-					spkg = _pacman_db_get_pkgfromcache(dbs, p->data);
+					_pacman_log(PM_LOG_DEBUG, _("found '%s' as a provision for '%s'"), ((pmpkg_t *)p->data)->name, targ);
+					spkg = _pacman_db_get_pkgfromcache(dbs, ((pmpkg_t *)p->data)->name);
 					FREELISTPTR(p);
 				}
 			}
@@ -157,8 +158,8 @@ int _pacman_sync_addtarget(pmtrans_t *trans, const char *name)
 				pmdb_t *dbs = j->data;
 				pmlist_t *p = _pacman_db_whatprovides(dbs, targ);
 				if(p) {
-					_pacman_log(PM_LOG_DEBUG, _("found '%s' as a provision for '%s'"), p->data, targ);
-					spkg = _pacman_db_get_pkgfromcache(dbs, p->data);
+					_pacman_log(PM_LOG_DEBUG, _("found '%s' as a provision for '%s'"), ((pmpkg_t *)p->data)->name, targ);
+					spkg = _pacman_db_get_pkgfromcache(dbs, ((pmpkg_t *)p->data)->name);
 					FREELISTPTR(p);
 				}
 			}
@@ -170,7 +171,7 @@ int _pacman_sync_addtarget(pmtrans_t *trans, const char *name)
 
 	local = _pacman_db_get_pkgfromcache(db_local, spkg->name);
 	if(local) {
-		cmp = _pacman_versioncmp(local->version, spkg->version);
+		cmp = _pacman_pkg_vercmp(local, spkg);
 		if(cmp > 0) {
 			/* local version is newer -- get confirmation before adding */
 			int resp = 0;
@@ -254,7 +255,6 @@ int _pacman_sync_prepare(pmtrans_t *trans, pmlist_t **data)
 {
 	pmlist_t *deps = NULL;
 	pmlist_t *list = NULL; /* list allowing checkdeps usage with data from trans->packages */
-	pmlist_t *trail = NULL; /* breadcrum list to avoid running into circles */
 	pmlist_t *asked = NULL;
 	pmlist_t *i, *j, *k, *l, *m;
 	int ret = 0;
@@ -274,18 +274,13 @@ int _pacman_sync_prepare(pmtrans_t *trans, pmlist_t **data)
 	}
 
 	if(!(trans->flags & PM_TRANS_FLAG_NODEPS)) {
-		trail = _pacman_list_new();
-
 		/* Resolve targets dependencies */
 		EVENT(trans, PM_TRANS_EVT_RESOLVEDEPS_START, NULL, NULL);
 		_pacman_log(PM_LOG_FLOW1, _("resolving targets dependencies"));
-		for(i = trans->packages; i; i = i->next) {
-			pmpkg_t *spkg = ((pmsyncpkg_t *)i->data)->pkg;
-			if(_pacman_resolvedeps(db_local, dbs_sync, spkg, list, trail, trans, data) == -1) {
-				/* pm_errno is set by resolvedeps */
-				ret = -1;
-				goto cleanup;
-			}
+		if(list && _pacman_resolvedeps(db_local, dbs_sync, list, trans, data) == -1) {
+			/* pm_errno is set by resolvedeps */
+			ret = -1;
+			goto cleanup;
 		}
 
 		for(i = list; i; i = i->next) {
@@ -315,7 +310,7 @@ int _pacman_sync_prepare(pmtrans_t *trans, pmlist_t **data)
 			pmsyncpkg_t *s = (pmsyncpkg_t*)i->data;
 			k = _pacman_list_add(k, s->pkg);
 		}
-		m = _pacman_sortbydeps(k, PM_TRANS_TYPE_ADD);
+		m = _pacman_sortbydeps(trans, k, PM_TRANS_TYPE_ADD);
 		for(i=m; i; i=i->next) {
 			for(j=trans->packages; j; j=j->next) {
 				pmsyncpkg_t *s = (pmsyncpkg_t*)j->data;
@@ -342,8 +337,6 @@ int _pacman_sync_prepare(pmtrans_t *trans, pmlist_t **data)
 			ret = -1;
 			goto cleanup;
 		}
-
-		FREELISTPTR(trail);
 	}
 
 	if(!(trans->flags & PM_TRANS_FLAG_NOCONFLICTS)) {
@@ -625,7 +618,6 @@ int _pacman_sync_prepare(pmtrans_t *trans, pmlist_t **data)
 
 cleanup:
 	FREELISTPTR(list);
-	FREELISTPTR(trail);
 	FREELIST(asked);
 
 	return(ret);
@@ -749,18 +741,23 @@ int _pacman_sync_commit(pmtrans_t *trans, pmlist_t **data)
 								 * here. */
 								continue;
 							}
+							_pacman_db_requiredby_remove(db_local, depender);
+							depender->depends = _pacman_pkg_editlist(depender, depender->depends);
 							for(m = depender->depends; m; m = m->next) {
 								if(!strcmp(m->data, old->name)) {
 									FREE(m->data);
 									m->data = strdup(new->name);
 								}
 							}
+							/* the new string may reuse the address of the old one */
+							FREE(depender->depcache);
+							_pacman_db_requiredby_add(db_local, depender);
 							if(_pacman_db_write(db_local, depender, INFRQ_DEPENDS) == -1) {
 								_pacman_log(PM_LOG_ERROR, _("could not update requiredby for database entry %s-%s"),
 								          new->name, new->version);
 							}
 							/* add the new requiredby */
-							new->requiredby = _pacman_list_add(new->requiredby, strdup(k->data));
+							new->requiredby = _pacman_list_add(_pacman_pkg_editlist(new, new->requiredby), strdup(k->data));
 						}
 					}
 				}
@@ -881,8 +878,8 @@ int _pacman_trans_download_commit(pmtrans_t *trans, pmlist_t **data)
 				char *ptr=NULL;
 
 				_pacman_pkg_filename(pkgname, sizeof(pkgname), spkg);
-				md5sum1 = spkg->md5sum;
-				sha1sum1 = spkg->sha1sum;
+				md5sum1 = PKG_COLD(spkg)->md5sum;
+				sha1sum1 = PKG_COLD(spkg)->sha1sum;
 
 				if((md5sum1 == NULL) && (sha1sum1 == NULL)) {
 					if((ptr = (char *)malloc(512)) == NULL) {
@@ -87,7 +87,7 @@ void _pacman_trans_free(pmtrans_t *trans)
 		FREELISTPKGS(trans->packages);
 	}
 
-	FREELIST(trans->skiplist);
+	FREELISTPTR(trans->skiplist);
 
 	_pacman_trans_fini(trans);
 	free(trans);
@@ -61,7 +61,7 @@ struct __pmtrans_t {
 	unsigned char state;
 	pmlist_t *targets;     /* pmlist_t of (char *) */
 	pmlist_t *packages;    /* pmlist_t of (pmpkg_t *) or (pmsyncpkg_t *) */
-	pmlist_t *skiplist;    /* pmlist_t of (char *) */
+	pmlist_t *skiplist;    /* pmlist_t of (char *), interned paths (see path.c) */
 	pmtrans_cbs_t cbs;
 };
 
@@ -82,51 +82,47 @@ int _pacman_sync_sysupgrade(pmtrans_t *trans, pmdb_t *db_local, pmlist_t *dbs_sy
 		for(j = _pacman_db_get_pkgcache(i->data); j; j = j->next) {
 			pmpkg_t *spkg = j->data;
 			for(k = _pacman_pkg_getinfo(spkg, PM_PKG_REPLACES); k; k = k->next) {
-				pmlist_t *m;
-				for(m = _pacman_db_get_pkgcache(db_local); m; m = m->next) {
-					pmpkg_t *lpkg = m->data;
-					if(!strcmp(k->data, lpkg->name)) {
-						_pacman_log(PM_LOG_DEBUG, _("checking replacement '%s' for package '%s'"), k->data, spkg->name);
-						if(_pacman_list_is_strin(lpkg->name, handle->ignorepkg)) {
-							_pacman_log(PM_LOG_WARNING, _("%s-%s: ignoring package upgrade (to be replaced by %s-%s)"),
-								lpkg->name, lpkg->version, spkg->name, spkg->version);
-						} else {
-							/* get confirmation for the replacement */
-							int doreplace = 0;
-							QUESTION(trans, PM_TRANS_CONV_REPLACE_PKG, lpkg, spkg, ((pmdb_t *)i->data)->treename, &doreplace);
-
-							if(doreplace) {
-								/* if confirmed, add this to the 'final' list, designating 'lpkg' as
-								 * the package to replace.
-								 */
-								pmsyncpkg_t *ps;
-								pmpkg_t *dummy = _pacman_pkg_new(lpkg->name, NULL);
-								if(dummy == NULL) {
+				pmpkg_t *lpkg = _pacman_db_get_pkgfromcache(db_local, k->data);
+				if(lpkg != NULL) {
+					_pacman_log(PM_LOG_DEBUG, _("checking replacement '%s' for package '%s'"), k->data, spkg->name);
+					if(_pacman_list_is_strin(lpkg->name, handle->ignorepkg)) {
+						_pacman_log(PM_LOG_WARNING, _("%s-%s: ignoring package upgrade (to be replaced by %s-%s)"),
+							lpkg->name, lpkg->version, spkg->name, spkg->version);
+					} else {
+						/* get confirmation for the replacement */
+						int doreplace = 0;
+						QUESTION(trans, PM_TRANS_CONV_REPLACE_PKG, lpkg, spkg, ((pmdb_t *)i->data)->treename, &doreplace);
+
+						if(doreplace) {
+							/* if confirmed, add this to the 'final' list, designating 'lpkg' as
+							 * the package to replace.
+							 */
+							pmsyncpkg_t *ps;
+							pmpkg_t *dummy = _pacman_pkg_new(lpkg->name, NULL);
+							if(dummy == NULL) {
+								pm_errno = PM_ERR_MEMORY;
+								goto error;
+							}
+							dummy->requiredby = _pacman_list_strdup(lpkg->requiredby);
+							/* check if spkg->name is already in the packages list. */
+							ps = find_pkginsync(spkg->name, trans->packages);
+							if(ps) {
+								/* found it -- just append to the replaces list */
+								ps->data = _pacman_list_add(ps->data, dummy);
+							} else {
+								/* none found -- enter pkg into the final sync list */
+								ps = _pacman_sync_new(PM_SYNC_TYPE_REPLACE, spkg, NULL);
+								if(ps == NULL) {
+									FREEPKG(dummy);
 									pm_errno = PM_ERR_MEMORY;
 									goto error;
 								}
-								dummy->requiredby = _pacman_list_strdup(lpkg->requiredby);
-								/* check if spkg->name is already in the packages list. */
-								ps = find_pkginsync(spkg->name, trans->packages);
-								if(ps) {
-									/* found it -- just append to the replaces list */
-									ps->data = _pacman_list_add(ps->data, dummy);
-								} else {
-									/* none found -- enter pkg into the final sync list */
-									ps = _pacman_sync_new(PM_SYNC_TYPE_REPLACE, spkg, NULL);
-									if(ps == NULL) {
-										FREEPKG(dummy);
-										pm_errno = PM_ERR_MEMORY;
-										goto error;
-									}
-									ps->data = _pacman_list_add(NULL, dummy);
-									trans->packages = _pacman_list_add(trans->packages, ps);
-								}
-								_pacman_log(PM_LOG_FLOW2, _("%s-%s elected for upgrade (to be replaced by %s-%s)"),
-								          lpkg->name, lpkg->version, spkg->name, spkg->version);
+								ps->data = _pacman_list_add(NULL, dummy);
+								trans->packages = _pacman_list_add(trans->packages, ps);
 							}
+							_pacman_log(PM_LOG_FLOW2, _("%s-%s elected for upgrade (to be replaced by %s-%s)"),
+							          lpkg->name, lpkg->version, spkg->name, spkg->version);
 						}
-						break;
 					}
 				}
 			}
@@ -166,7 +162,7 @@ int _pacman_sync_sysupgrade(pmtrans_t *trans, pmdb_t *db_local, pmlist_t *dbs_sy
 		}
 
 		/* compare versions and see if we need to upgrade */
-		cmp = _pacman_versioncmp(local->version, spkg->version);
+		cmp = _pacman_pkg_vercmp(local, spkg);
 		if(cmp > 0 && !_pacman_pkg_getinfo(spkg, PM_PKG_FORCE) && !(trans->flags & PM_TRANS_FLAG_DOWNGRADE)) {
 			/* local version is newer */
 			_pacman_log(PM_LOG_WARNING, _("%s-%s: local version is newer"),
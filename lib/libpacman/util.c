@@ -55,6 +55,10 @@
 #include <mntent.h>
 #endif
 #include <regex.h>
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/syscall.h>
+#endif
 
 /* pacman-g2 */
 #include "log.h"
@@ -293,32 +297,26 @@ int _pacman_unpack(const char *archive, const char *prefix, const char *fn)
 	struct archive_entry *entry;
 	char expath[PATH_MAX];
 	pmlist_t *cache = NULL, *i;
-	DIR *dirhandle;
-	struct dirent *ent;
-	struct stat buf;
+	pmdir_t *dirhandle;
+	const char *name;
 
 	/* first scan though the old dir to see what package entries do we have */
-	dirhandle = opendir(prefix);
+	dirhandle = _pacman_opendir(prefix);
 	if (dirhandle != NULL) {
-		while((ent = readdir(dirhandle)) != NULL) {
+		/* we cache only dirs */
+		while((name = _pacman_readsubdir(dirhandle)) != NULL) {
 			cache_t *c;
-			if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-				continue;
-			}
-			/* we cache only dirs */
-			snprintf(expath, PATH_MAX, "%s/%s", prefix, ent->d_name);
-			if(stat(expath, &buf) || !S_ISDIR(buf.st_mode)) {
-				continue;
-			}
 			c = _pacman_malloc(sizeof(cache_t));
-			if (!c)
+			if (!c) {
+				_pacman_closedir(dirhandle);
 				return(-1);
+			}
 			memset(c, 0, sizeof(cache_t));
-			c->str = strdup(ent->d_name);
+			c->str = strdup(name);
 			cache = _pacman_list_add(cache, c);
 		}
 	}
-	closedir(dirhandle);
+	_pacman_closedir(dirhandle);
 
 	/* now extract the new entries */
 	if ((_archive = archive_read_new ()) == NULL)
@@ -809,35 +807,274 @@ int _pacman_reg_match(char *string, char *pattern)
 	return(!(result));
 }
 
-char *_pacman_archive_fgets(char *line, size_t size, struct archive *a)
+#endif
+
+/* Buffered reader for the data of archive entries: whole data blocks are
+ * pulled from libarchive and lines are served out of them.
+ */
+pmreader_t *_pacman_reader_new(struct archive *archive)
 {
-	/* for now, just read one char at a time until we get to a
-	 * '\n' char. we can optimize this later with an internal
-	 * buffer. */
-	/* leave room for zero terminator */
-	char *last = line + size - 1;
-	char *i;
-
-	for(i = line; i < last; i++) {
-		int ret = archive_read_data(a, i, 1);
-		/* special check for first read- if null, return null,
-		 * this indicates EOF */
-		if(i == line && (ret <= 0 || *i == '\0')) {
-			return(NULL);
+	pmreader_t *reader = _pacman_zalloc(sizeof(pmreader_t));
+
+	if(reader == NULL) {
+		return(NULL);
+	}
+	reader->archive = archive;
+
+	return(reader);
+}
+
+void _pacman_reader_free(pmreader_t *reader)
+{
+	if(reader == NULL) {
+		return;
+	}
+
+	FREE(reader->line);
+	free(reader);
+}
+
+/* Prepares reader for the data of the entry whose header was just read */
+void _pacman_reader_reset(pmreader_t *reader)
+{
+	reader->block = NULL;
+	reader->size = 0;
+	reader->pos = 0;
+	reader->eof = 0;
+}
+
+/* Makes sure there is unread data in the current block.
+ * Returns 0 at the end of the entry.
+ */
+static int _pacman_reader_fill(pmreader_t *reader)
+{
+	const void *block;
+	size_t size;
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+	int64_t offset;
+#else
+	off_t offset;
+#endif
+
+	while(reader->pos >= reader->size) {
+		int ret;
+
+		if(reader->eof) {
+			return(0);
 		}
-		/* check if read value was null or newline */
-		if(ret <= 0 || *i == '\0' || *i == '\n') {
-			last = i + 1;
-			break;
+		ret = archive_read_data_block(reader->archive, &block, &size, &offset);
+		if(ret == ARCHIVE_EOF || ret < ARCHIVE_WARN) {
+			reader->eof = 1;
+			return(0);
 		}
+		reader->block = block;
+		reader->size = size;
+		reader->pos = 0;
+	}
+
+	return(1);
+}
+
+/* Returns the next line of the current entry and stores its length
+ * (without the newline) in len, or NULL at the end of the entry.
+ * A line is served straight from the data block when it can be, so it is
+ * not NUL terminated and is only valid until the next read.
+ */
+const char *_pacman_reader_getline(pmreader_t *reader, size_t *len)
+{
+	const char *start, *nl;
+	size_t used = 0;
+
+	if(!_pacman_reader_fill(reader)) {
+		return(NULL);
+	}
+	start = reader->block + reader->pos;
+	if((nl = memchr(start, '\n', reader->size - reader->pos)) != NULL) {
+		*len = nl - start;
+		reader->pos += *len + 1;
+		return(start);
 	}
 
-	/* always null terminate the buffer */
-	*last = '\0';
+	/* the line spans several blocks, gather it */
+	do {
+		size_t n;
+
+		start = reader->block + reader->pos;
+		nl = memchr(start, '\n', reader->size - reader->pos);
+		n = nl ? (size_t)(nl - start) : reader->size - reader->pos;
+		if(used + n + 1 > reader->linesize) {
+			size_t linesize = reader->linesize ? reader->linesize : 256;
+			char *line;
+
+			while(used + n + 1 > linesize) {
+				linesize *= 2;
+			}
+			if((line = realloc(reader->line, linesize)) == NULL) {
+				RET_ERR(PM_ERR_MEMORY, NULL);
+			}
+			reader->line = line;
+			reader->linesize = linesize;
+		}
+		memcpy(reader->line + used, start, n);
+		used += n;
+		reader->pos += nl ? n + 1 : n;
+	} while(nl == NULL && _pacman_reader_fill(reader));
+	reader->line[used] = '\0';
+	*len = used;
+
+	return(reader->line);
+}
+
+/* fgets() like interface: copies at most size-1 bytes of the current
+ * entry into line, up to and including the next newline.
+ */
+char *_pacman_reader_fgets(pmreader_t *reader, char *line, size_t size)
+{
+	size_t used = 0;
+
+	while(used < size - 1 && _pacman_reader_fill(reader)) {
+		const char *start = reader->block + reader->pos;
+		size_t n = reader->size - reader->pos;
+		const char *nl;
+
+		if(n > size - 1 - used) {
+			n = size - 1 - used;
+		}
+		if((nl = memchr(start, '\n', n)) != NULL) {
+			n = nl - start + 1;
+		}
+		memcpy(line + used, start, n);
+		used += n;
+		reader->pos += n;
+		if(nl) {
+			break;
+		}
+	}
+	if(used == 0) {
+		return(NULL);
+	}
+	line[used] = '\0';
 
 	return(line);
 }
 
+#ifdef __linux__
+/* the kernel record returned by getdents64(2) */
+struct __pmdirent64_t {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+#define PM_DIRBUF_SIZE 32768
+#endif
+
+pmdir_t *_pacman_opendir(const char *path)
+{
+	pmdir_t *dir = _pacman_zalloc(sizeof(pmdir_t));
+
+	if(dir == NULL) {
+		return(NULL);
+	}
+#ifdef __linux__
+	dir->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(dir->fd == -1 || (dir->buf = _pacman_malloc(PM_DIRBUF_SIZE)) == NULL) {
+		_pacman_closedir(dir);
+		return(NULL);
+	}
+#else
+	if((dir->dir = opendir(path)) == NULL) {
+		free(dir);
+		return(NULL);
+	}
+	dir->fd = dirfd(dir->dir);
+#endif
+	return(dir);
+}
+
+void _pacman_closedir(pmdir_t *dir)
+{
+	if(dir == NULL) {
+		return;
+	}
+#ifdef __linux__
+	if(dir->fd != -1) {
+		close(dir->fd);
+	}
+	FREE(dir->buf);
+#else
+	closedir(dir->dir);
 #endif
+	free(dir);
+}
+
+void _pacman_rewinddir(pmdir_t *dir)
+{
+#ifdef __linux__
+	lseek(dir->fd, 0, SEEK_SET);
+	dir->len = dir->pos = 0;
+#else
+	rewinddir(dir->dir);
+#endif
+}
+
+/* Returns the name of the next subdirectory of dir, skipping "." and "..",
+ * or NULL at the end of the stream. The entry type comes from the directory
+ * itself, fstatat() relative to the directory is only needed when the
+ * filesystem does not report it (or for symlinks, which are followed).
+ */
+const char *_pacman_readsubdir(pmdir_t *dir)
+{
+	const char *name;
+	unsigned char type;
+	struct stat buf;
+
+	while(1) {
+#ifdef __linux__
+		struct __pmdirent64_t *ent;
+
+		if(dir->pos >= dir->len) {
+			long len = syscall(SYS_getdents64, dir->fd, dir->buf, PM_DIRBUF_SIZE);
+			if(len <= 0) {
+				return(NULL);
+			}
+			dir->len = len;
+			dir->pos = 0;
+		}
+		ent = (struct __pmdirent64_t *)(dir->buf + dir->pos);
+		dir->pos += ent->d_reclen;
+		name = ent->d_name;
+		type = ent->d_type;
+#else
+		struct dirent *ent = readdir(dir->dir);
+
+		if(ent == NULL) {
+			return(NULL);
+		}
+		name = ent->d_name;
+#ifdef DT_UNKNOWN
+		type = ent->d_type;
+#else
+		type = 0;
+#endif
+#endif
+		if(!strcmp(name, ".") || !strcmp(name, "..")) {
+			continue;
+		}
+#ifdef DT_DIR
+		if(type == DT_DIR) {
+			return(name);
+		}
+		if(type != DT_UNKNOWN && type != DT_LNK) {
+			continue;
+		}
+#endif
+		if(!fstatat(dir->fd, name, &buf, 0) && S_ISDIR(buf.st_mode)) {
+			return(name);
+		}
+	}
+}
 
 /* vim: set ts=2 sw=2 noet: */
@@ -37,6 +37,9 @@
 #include <archive_entry.h>
 #endif
 #include <libintl.h>
+#ifndef __linux__
+#include <dirent.h>
+#endif
 
 #include "error.h"
 
@@ -82,7 +85,40 @@ int _pacman_reg_match(char *string, char *pattern);
 char* strsep(char** str, const char* delims);
 char* mkdtemp(char *template);
 #endif
-char *_pacman_archive_fgets(char *line, size_t size, struct archive *a);
+
+/* Buffered line reader over the data of an archive entry */
+typedef struct __pmreader_t {
+	struct archive *archive;
+	const char *block;
+	size_t size;
+	size_t pos;
+	char *line; /* lines spanning several blocks are gathered here */
+	size_t linesize;
+	int eof;
+} pmreader_t;
+
+pmreader_t *_pacman_reader_new(struct archive *archive);
+void _pacman_reader_free(pmreader_t *reader);
+void _pacman_reader_reset(pmreader_t *reader);
+const char *_pacman_reader_getline(pmreader_t *reader, size_t *len);
+char *_pacman_reader_fgets(pmreader_t *reader, char *line, size_t size);
+
+/* Directory stream, read in batches with getdents64(2) on Linux */
+typedef struct __pmdir_t {
+	int fd;
+#ifdef __linux__
+	char *buf;
+	size_t len;
+	size_t pos;
+#else
+	DIR *dir;
+#endif
+} pmdir_t;
+
+pmdir_t *_pacman_opendir(const char *path);
+void _pacman_closedir(pmdir_t *dir);
+void _pacman_rewinddir(pmdir_t *dir);
+const char *_pacman_readsubdir(pmdir_t *dir);
 
 static inline void *_pacman_malloc(size_t size)
 {
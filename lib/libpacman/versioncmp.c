@@ -147,100 +147,107 @@ static int strverscmp (s1, s2)
 
 #endif
 
-/* this function was taken from rpm 4.0.4 and rewritten */
-int _pacman_versioncmp(const char *a, const char *b)
+/* Tags of the version keys, they never appear in a segment */
+#define VERKEY_END   '\1' /* end of the key */
+#define VERKEY_REL   '\2' /* the release key follows */
+#define VERKEY_NUM   '\3' /* a numeric segment follows */
+#define VERKEY_ALPHA '\4' /* an alphabetic segment follows */
+
+static char *_pacman_verkey_split(const char *str, const char *end, char *key)
 {
-	char str1[64], str2[64];
-	char *ptr1, *ptr2;
-	char *one, *two;
-	char *rel1 = NULL, *rel2 = NULL;
-	char oldch1, oldch2;
-	int is1num, is2num;
-	int rc;
+	const char *rel, *seg;
 
-	if(!strcmp(a,b)) {
-		return(0);
-	}
+	/* lose the release number */
+	for(rel = str; rel < end && *rel != '-'; rel++);
 
-	strncpy(str1, a, 64);
-	str1[63] = 0;
-	strncpy(str2, b, 64);
-	str2[63] = 0;
+	while(str < rel) {
+		while(str < rel && !isalnum((int)*str)) str++;
+		if(str == rel) {
+			break;
+		}
 
-	/* lose the release number */
-	for(one = str1; *one && *one != '-'; one++);
-	if(one) {
-		*one = '\0';
-		rel1 = ++one;
-	}
-	for(two = str2; *two && *two != '-'; two++);
-	if(two) {
-		*two = '\0';
-		rel2 = ++two;
+		/* find the next segment */
+		seg = str;
+		if(isdigit((int)*str)) {
+			*key++ = VERKEY_NUM;
+			while(str < rel && isdigit((int)*str)) str++;
+			while(seg < str && *seg == '0') seg++;
+		} else {
+			*key++ = VERKEY_ALPHA;
+			while(str < rel && isalpha((int)*str)) str++;
+		}
+		memcpy(key, seg, str - seg);
+		key += str - seg;
+		*key++ = '\0';
 	}
 
-	one = str1;
-	two = str2;
+	if(rel + 1 < end) {
+		*key++ = VERKEY_REL;
+		return(_pacman_verkey_split(rel + 1, end, key));
+	}
+	*key++ = VERKEY_END;
+	return(key);
+}
 
-	while(*one || *two) {
-		while(*one && !isalnum((int)*one)) one++;
-		while(*two && !isalnum((int)*two)) two++;
+/* Splits version once for all in the segments _pacman_verkey_cmp() compares.
+ * key must hold PM_VERKEY_MAX bytes; returns the length of the key.
+ */
+size_t _pacman_verkey(const char *version, char *key)
+{
+	/* only the first 63 characters were ever compared */
+	return(_pacman_verkey_split(version, version + strnlen(version, 63), key) - key);
+}
 
-		ptr1 = one;
-		ptr2 = two;
+/* this function was taken from rpm 4.0.4 and rewritten */
+int _pacman_verkey_cmp(const char *one, const char *two)
+{
+	int rc;
 
-		/* find the next segment for each string */
-		if(isdigit((int)*ptr1)) {
-			is1num = 1;
-			while(*ptr1 && isdigit((int)*ptr1)) ptr1++;
-		} else {
-			is1num = 0;
-			while(*ptr1 && isalpha((int)*ptr1)) ptr1++;
-		}
-		if(isdigit((int)*ptr2)) {
-			is2num = 1;
-			while(*ptr2 && isdigit((int)*ptr2)) ptr2++;
-		} else {
-			is2num = 0;
-			while(*ptr2 && isalpha((int)*ptr2)) ptr2++;
+	while(1) {
+		char tag1 = *one++, tag2 = *two++;
+		int is1seg = (tag1 == VERKEY_NUM || tag1 == VERKEY_ALPHA);
+		int is2seg = (tag2 == VERKEY_NUM || tag2 == VERKEY_ALPHA);
+
+		if(!is1seg && !is2seg) {
+			/* compare release numbers */
+			if(tag1 == VERKEY_REL && tag2 == VERKEY_REL) {
+				continue;
+			}
+			return(0);
 		}
 
-		oldch1 = *ptr1;
-		*ptr1 = '\0';
-		oldch2 = *ptr2;
-		*ptr2 = '\0';
-
 		/* see if we ran out of segments on one string */
-		if(one == ptr1 && two != ptr2) {
-			return(is2num ? -1 : 1);
+		if(!is1seg) {
+			return(tag2 == VERKEY_NUM ? -1 : 1);
 		}
-		if(one != ptr1 && two == ptr2) {
-			return(is1num ? 1 : -1);
+		if(!is2seg) {
+			return(tag1 == VERKEY_NUM ? 1 : -1);
 		}
 
 		/* see if we have a type mismatch (ie, one is alpha and one is digits) */
-		if(is1num && !is2num) return(1);
-		if(!is1num && is2num) return(-1);
-
-		if(is1num) while(*one == '0') one++;
-		if(is2num) while(*two == '0') two++;
+		if(tag1 != tag2) {
+			return(tag1 == VERKEY_NUM ? 1 : -1);
+		}
 
 		rc = strverscmp(one, two);
 		if(rc) return(rc);
 
-		*ptr1 = oldch1;
-		*ptr2 = oldch2;
-		one = ptr1;
-		two = ptr2;
+		one += strlen(one) + 1;
+		two += strlen(two) + 1;
 	}
+}
 
-	if((!*one) && (!*two)) {
-		/* compare release numbers */
-		if(rel1 && rel2 && strlen(rel1) && strlen(rel2)) return(_pacman_versioncmp(rel1, rel2));
+int _pacman_versioncmp(const char *a, const char *b)
+{
+	char key1[PM_VERKEY_MAX], key2[PM_VERKEY_MAX];
+
+	if(!strcmp(a,b)) {
 		return(0);
 	}
 
-	return(*one ? 1 : -1);
+	_pacman_verkey(a, key1);
+	_pacman_verkey(b, key2);
+	return(_pacman_verkey_cmp(key1, key2));
 }
 
 /* vim: set ts=2 sw=2 noet: */
@@ -23,6 +23,14 @@
 #ifndef _PM_RPMVERCMP_H
 #define _PM_RPMVERCMP_H
 
+#include <stddef.h>
+
+/* Room for the key of any version: a segment takes at most 3 bytes per
+ * character of the (63 characters long at most) version */
+#define PM_VERKEY_MAX 192
+
+size_t _pacman_verkey(const char *version, char *key);
+int _pacman_verkey_cmp(const char *one, const char *two);
 int _pacman_versioncmp(const char *a, const char *b);
 
 #endif
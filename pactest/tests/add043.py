@@ -0,0 +1,19 @@
+self.description = "Install packages with a dependency cycle"
+
+p1 = pmpkg("dummy")
+p1.files = ["bin/dummy"]
+p1.depends = ["dep1"]
+
+p2 = pmpkg("dep1")
+p2.files = ["bin/dep1"]
+p2.depends = ["dummy"]
+
+for p in p1, p2:
+	self.addpkg(p)
+
+self.args = "-A %s" % " ".join([p.filename() for p in (p1, p2)])
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=dependency cycle detected: dummy dep1")
+self.addrule("PKG_EXIST=dummy")
+self.addrule("PKG_EXIST=dep1")
@@ -0,0 +1,19 @@
+self.description = "Install a package depending on itself"
+
+p1 = pmpkg("dep1")
+p1.files = ["bin/dep1"]
+p1.depends = ["dep1", "dep2"]
+
+p2 = pmpkg("dep2")
+p2.files = ["bin/dep2"]
+
+for p in p1, p2:
+	self.addpkg(p)
+
+self.args = "-A %s" % " ".join([p.filename() for p in (p1, p2)])
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=dependency cycle detected: dep1")
+self.addrule("!PACMAN_OUTPUT=dependency cycle detected: dep2")
+self.addrule("PKG_EXIST=dep1")
+self.addrule("PKG_EXIST=dep2")
@@ -0,0 +1,13 @@
+self.description = "Query the owner of a file"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+self.filesystem = ["bin/other"]
+
+self.args = "-Qo ../bin/foobar ../bin/other"
+
+self.addrule("PACMAN_OUTPUT=foobar 1.0-1 is an owner of ../bin/foobar")
+self.addrule("PACMAN_OUTPUT=No package owns ../bin/other")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/local.owners")
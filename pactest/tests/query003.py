@@ -0,0 +1,24 @@
+self.description = "Query the owners of files of two packages"
+
+p1 = pmpkg("pkg1")
+p1.files = ["bin/",
+            "bin/pkg1",
+            "share/common"]
+
+p2 = pmpkg("pkg2")
+p2.files = ["bin/",
+            "bin/pkg2",
+            "share/common"]
+
+for p in p1, p2:
+	self.addpkg2db("local", p)
+
+self.args = "-Qo ../share/common ../bin ../bin/pkg2"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=pkg1 1.0-1 is an owner of ../share/common")
+self.addrule("PACMAN_OUTPUT=pkg2 1.0-1 is an owner of ../share/common")
+self.addrule("PACMAN_OUTPUT=pkg1 1.0-1 is an owner of ../bin")
+self.addrule("PACMAN_OUTPUT=pkg2 1.0-1 is an owner of ../bin")
+self.addrule("PACMAN_OUTPUT=pkg2 1.0-1 is an owner of ../bin/pkg2")
+self.addrule("!PACMAN_OUTPUT=pkg1 1.0-1 is an owner of ../bin/pkg2")
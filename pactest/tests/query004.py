@@ -0,0 +1,13 @@
+self.description = "Query the owner of a file with a corrupted owners index"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+self.filesystem = ["var/lib/pacman-g2/local.owners"]
+
+self.args = "-Qo ../bin/foobar"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=foobar 1.0-1 is an owner of ../bin/foobar")
+self.addrule("FILE_MODIFIED=var/lib/pacman-g2/local.owners")
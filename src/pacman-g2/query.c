@@ -41,6 +41,46 @@ extern config_t *config;
 extern PM_DB *db_local;
 extern list_t *pmc_syncs;
 
+/* determine the owners of the files, looking for all of them at once */
+static int query_owners(list_t *targets)
+{
+	char **files;
+	PM_LIST **owners, *lp;
+	list_t *i;
+	int count = list_count(targets), n, errors = 0;
+
+	if(count == 0) {
+		ERR(NL, _("no file was specified for --owns\n"));
+		return(1);
+	}
+	MALLOC(files, (count * sizeof(char *)));
+	MALLOC(owners, (count * sizeof(PM_LIST *)));
+	for(i = targets, n = 0; i; i = i->next, n++) {
+		files[n] = i->data;
+	}
+	if(pacman_pkg_getowners_list(files, count, owners) == -1) {
+		ERR(NL, _("failed to find the owners of the files (%s)\n"), pacman_strerror(pm_errno));
+		FREE(files);
+		FREE(owners);
+		return(1);
+	}
+	for(n = 0; n < count; n++) {
+		if(owners[n] == NULL) {
+			ERR(NL, _("No package owns %s\n"), files[n]);
+			errors++;
+			continue;
+		}
+		for(lp = pacman_list_first(owners[n]); lp; lp = pacman_list_next(lp)) {
+			PM_PKG *pkg = pacman_list_getdata(lp);
+			printf(_("%s %s is an owner of %s\n"), (char *)pacman_pkg_getinfo(pkg, PM_PKG_NAME),
+					(char *)pacman_pkg_getinfo(pkg, PM_PKG_VERSION), files[n]);
+		}
+	}
+	FREE(files);
+	FREE(owners);
+	return(errors);
+}
+
 int querypkg(list_t *targets)
 {
 	PM_PKG *info = NULL;
@@ -90,6 +130,10 @@ int querypkg(list_t *targets)
 		}
 	}
 
+	if(config->op_q_owns && !config->group && !config->op_q_isfile) {
+		return(query_owners(targets));
+	}
+
 	for(targ = targets; !done; targ = (targ ? targ->next : NULL)) {
 		if(targets == NULL) {
 			done = 1;
@@ -156,23 +200,6 @@ int querypkg(list_t *targets)
 			continue;
 		}
 
-		/* determine the owner of a file */
-		if(config->op_q_owns) {
-				PM_LIST *data;
-			if((data = pacman_pkg_getowners(package)) == NULL) {
-				ERR(NL, _("No package owns %s\n"), package);
-				errors++;
-			} else {
-				PM_LIST *lp;
-				for(lp = pacman_list_first(data); lp; lp = pacman_list_next(lp)) {
-					PM_PKG *pkg = pacman_list_getdata(lp);
-					printf(_("%s %s is an owner of %s\n"), (char *)pacman_pkg_getinfo(pkg, PM_PKG_NAME),
-							(char *)pacman_pkg_getinfo(pkg, PM_PKG_VERSION), package);
-				}
-			}
-			continue;
-		}
-
 		/* find packages in the db */
 		if(package == NULL) {
 			/* Do not allow -Qc , -Qi , -Ql without package arg .. */
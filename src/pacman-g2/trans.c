@@ -51,6 +51,7 @@ void cb_trans_evt(unsigned char event, void *data1, void *data2)
 	char str[LOG_STR_LEN] = "";
 	char out[PATH_MAX];
 	int i;
+	PM_LIST *lp;
 
 	switch(event) {
 		case PM_TRANS_EVT_CHECKDEPS_START:
@@ -169,6 +170,13 @@ void cb_trans_evt(unsigned char event, void *data1, void *data2)
 			}
 			fputs(_("] 100%    LOCAL "), stdout);
 		break;
+		case PM_TRANS_EVT_DEPCYCLE:
+			WARN(NL, _("dependency cycle detected:"));
+			for(lp = pacman_list_first(data1); lp; lp = pacman_list_next(lp)) {
+				pm_fprintf(stderr, CL, " %s", (char *)pacman_pkg_getinfo(pacman_list_getdata(lp), PM_PKG_NAME));
+			}
+			pm_fprintf(stderr, CL, "\n");
+		break;
 	}
 }
 
@@ -0,0 +1,278 @@
+/*
+ *  vercmptest.c
+ *
+ *  Copyright (c) 2013 by Michel Hermier <hermier@frugalware.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* Differential test of the key based version comparison against the
+ * string based one it replaced: both must return the very same values.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "versioncmp.h"
+
+/* exit status automake reports as a skipped test */
+#define SKIP 77
+
+/* all the versions up to this length over ALPHABET are compared pairwise */
+#define SHORT_LEN 4
+#define ALPHABET "01a9Z.-_"
+
+/* then this many random long versions pairs */
+#define RANDOM_COUNT 200000
+#define RANDOM_ALPHABET "0012345789abcxyzAZ._+-"
+
+#define MAX_REPORT 10
+
+#ifdef HAVE_STRVERSCMP
+/* _pacman_versioncmp() as it was before the version keys */
+static int versioncmp_ref(const char *a, const char *b)
+{
+	char str1[64], str2[64];
+	char *ptr1, *ptr2;
+	char *one, *two;
+	char *rel1 = NULL, *rel2 = NULL;
+	char oldch1, oldch2;
+	int is1num, is2num;
+	int rc;
+
+	if(!strcmp(a,b)) {
+		return(0);
+	}
+
+	strncpy(str1, a, 64);
+	str1[63] = 0;
+	strncpy(str2, b, 64);
+	str2[63] = 0;
+
+	/* lose the release number */
+	for(one = str1; *one && *one != '-'; one++);
+	if(one) {
+		*one = '\0';
+		rel1 = ++one;
+	}
+	for(two = str2; *two && *two != '-'; two++);
+	if(two) {
+		*two = '\0';
+		rel2 = ++two;
+	}
+
+	one = str1;
+	two = str2;
+
+	while(*one || *two) {
+		while(*one && !isalnum((int)*one)) one++;
+		while(*two && !isalnum((int)*two)) two++;
+
+		ptr1 = one;
+		ptr2 = two;
+
+		/* find the next segment for each string */
+		if(isdigit((int)*ptr1)) {
+			is1num = 1;
+			while(*ptr1 && isdigit((int)*ptr1)) ptr1++;
+		} else {
+			is1num = 0;
+			while(*ptr1 && isalpha((int)*ptr1)) ptr1++;
+		}
+		if(isdigit((int)*ptr2)) {
+			is2num = 1;
+			while(*ptr2 && isdigit((int)*ptr2)) ptr2++;
+		} else {
+			is2num = 0;
+			while(*ptr2 && isalpha((int)*ptr2)) ptr2++;
+		}
+
+		oldch1 = *ptr1;
+		*ptr1 = '\0';
+		oldch2 = *ptr2;
+		*ptr2 = '\0';
+
+		/* see if we ran out of segments on one string */
+		if(one == ptr1 && two != ptr2) {
+			return(is2num ? -1 : 1);
+		}
+		if(one != ptr1 && two == ptr2) {
+			return(is1num ? 1 : -1);
+		}
+
+		/* see if we have a type mismatch (ie, one is alpha and one is digits) */
+		if(is1num && !is2num) return(1);
+		if(!is1num && is2num) return(-1);
+
+		if(is1num) while(*one == '0') one++;
+		if(is2num) while(*two == '0') two++;
+
+		rc = strverscmp(one, two);
+		if(rc) return(rc);
+
+		*ptr1 = oldch1;
+		*ptr2 = oldch2;
+		one = ptr1;
+		two = ptr2;
+	}
+
+	if((!*one) && (!*two)) {
+		/* compare release numbers */
+		if(rel1 && rel2 && strlen(rel1) && strlen(rel2)) return(versioncmp_ref(rel1, rel2));
+		return(0);
+	}
+
+	return(*one ? 1 : -1);
+}
+
+/* The dependency checks used to drop the release of the package version when
+ * the dependency had none, the keys compare only the common releases.
+ */
+static int depcmp_ref(const char *pkgver, const char *depver)
+{
+	char tmp[64], *ptr;
+
+	strncpy(tmp, pkgver, 64);
+	tmp[63] = 0;
+	if(strchr(depver, '-') == NULL && (ptr = strchr(tmp, '-')) != NULL) {
+		*ptr = '\0';
+	}
+	return(versioncmp_ref(tmp, depver));
+}
+
+static int failures = 0;
+
+static void check(const char *what, const char *a, const char *b, int expected, int got)
+{
+	if(expected != got) {
+		if(failures < MAX_REPORT) {
+			fprintf(stderr, "%s(\"%s\", \"%s\"): expected %d, got %d\n", what, a, b, expected, got);
+		}
+		failures++;
+	}
+}
+
+/* The reference reads past the version buffer when the first 63 characters
+ * have no release separator, don't feed it such versions.
+ */
+static void fix_release(char *version)
+{
+	if(strlen(version) >= 63 && memchr(version, '-', 62) == NULL) {
+		version[rand() % 62] = '-';
+	}
+}
+
+static void random_version(char *version)
+{
+	int i, len = 40 + rand() % 40;
+
+	for(i = 0; i < len; i++) {
+		version[i] = RANDOM_ALPHABET[rand() % (sizeof(RANDOM_ALPHABET) - 1)];
+	}
+	version[len] = '\0';
+	fix_release(version);
+}
+
+int main(void)
+{
+	const int base = sizeof(ALPHABET) - 1;
+	int count, len, i, j;
+	long pairs = 0;
+	char (*versions)[SHORT_LEN + 1];
+	char (*keys)[PM_VERKEY_MAX];
+
+	/* enumerate all the versions up to SHORT_LEN characters */
+	for(count = 0, len = 0, i = 1; len <= SHORT_LEN; len++, i *= base) {
+		count += i;
+	}
+	versions = malloc(count * sizeof(*versions));
+	keys = malloc(count * sizeof(*keys));
+	if(versions == NULL || keys == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return(1);
+	}
+	for(count = 0, len = 0; len <= SHORT_LEN; len++) {
+		int n, total = 1;
+
+		for(i = 0; i < len; i++) {
+			total *= base;
+		}
+		for(n = 0; n < total; n++, count++) {
+			int rest = n;
+
+			for(i = 0; i < len; i++, rest /= base) {
+				versions[count][i] = ALPHABET[rest % base];
+			}
+			versions[count][len] = '\0';
+			_pacman_verkey(versions[count], keys[count]);
+		}
+	}
+
+	for(i = 0; i < count; i++) {
+		const char *a = versions[i];
+
+		for(j = 0; j < count; j++) {
+			const char *b = versions[j];
+			int expected = versioncmp_ref(a, b);
+
+			check("_pacman_versioncmp", a, b, expected, _pacman_versioncmp(a, b));
+			check("_pacman_verkey_cmp", a, b, expected, _pacman_verkey_cmp(keys[i], keys[j]));
+			if(strchr(b, '-') == NULL) {
+				check("depcmp", a, b, depcmp_ref(a, b), _pacman_verkey_cmp(keys[i], keys[j]));
+			}
+			pairs++;
+		}
+	}
+
+	srand(1);
+	for(i = 0; i < RANDOM_COUNT; i++) {
+		char a[80], b[80], key1[PM_VERKEY_MAX], key2[PM_VERKEY_MAX];
+		int expected;
+
+		random_version(a);
+		/* share a prefix to get past the first segments */
+		if(i & 1) {
+			strcpy(b, a);
+			b[rand() % strlen(b)] = RANDOM_ALPHABET[rand() % (sizeof(RANDOM_ALPHABET) - 1)];
+			fix_release(b);
+		} else {
+			random_version(b);
+		}
+		_pacman_verkey(a, key1);
+		_pacman_verkey(b, key2);
+		expected = versioncmp_ref(a, b);
+		check("_pacman_versioncmp", a, b, expected, _pacman_versioncmp(a, b));
+		check("_pacman_verkey_cmp", a, b, expected, _pacman_verkey_cmp(key1, key2));
+		pairs++;
+	}
+
+	free(versions);
+	free(keys);
+	printf("%ld version pairs compared, %d differences\n", pairs, failures);
+	return(failures ? 1 : 0);
+}
+#else
+int main(void)
+{
+	/* the reference relies on the strverscmp() of the C library */
+	return(SKIP);
+}
+#endif
+
+/* vim: set ts=2 sw=2 noet: */